@@ -0,0 +1,226 @@
+#include "flightRecorderFormat.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @file main.cpp
+ * @brief Command-line reader for HapticEnvironment flight recorder files.
+ *
+ * Usage: flightRecorderDump <file> [--count <n>] [--csv <prefix>]
+ *
+ * Prints how the run ended (closed, crashed and on which signal, or still running) and the last n
+ * messages, frames and ticks (default 20). --csv writes every complete entry of each ring to
+ * <prefix>_ticks.csv, <prefix>_messages.csv and <prefix>_frames.csv. Times are on the
+ * getSteadyTime clock; the header's clock offset puts them on MessageHandler's clock. The file can
+ * be read while HapticEnvironment is still writing it.
+ */
+
+static const char* stateName(uint32_t state)
+{
+  switch (state) {
+    case FLIGHT_STATE_RUNNING: return "running or killed";
+    case FLIGHT_STATE_CLOSED: return "closed";
+    case FLIGHT_STATE_CRASHED: return "crashed";
+    default: return "unknown";
+  }
+}
+
+/**
+ * Checks that ring lies inside the file and holds entries of the expected size.
+ */
+static bool checkRing(const FlightRing& ring, size_t entrySize, size_t fileSize, const char* name)
+{
+  if (ring.entrySize != entrySize || ring.capacity == 0
+      || ring.offset + (uint64_t) ring.capacity*ring.entrySize > fileSize) {
+    cout << "The " << name << " ring does not match this version of the tool." << endl;
+    return false;
+  }
+  return true;
+}
+
+template <typename T>
+static const T& entryAt(const vector<char>& file, const FlightRing& ring, uint64_t i)
+{
+  return *(const T*) (file.data() + ring.offset + (i % ring.capacity)*ring.entrySize);
+}
+
+static void printHeader(const FlightHeader& header)
+{
+  time_t started = (time_t) header.startTime;
+  char date[64] = "";
+  strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&started));
+  cout << "Version:  " << header.version << endl;
+  cout << "State:    " << stateName(header.state);
+  if (header.state == FLIGHT_STATE_CRASHED) {
+    cout << " (signal " << header.signal << ")";
+  }
+  cout << endl;
+  cout << "Process:  " << header.pid << endl;
+  cout << "Started:  " << date << endl;
+  if (header.stopTime != 0.0) {
+    printf("Stopped:  %.6f\n", header.stopTime);
+  }
+  printf("Offset:   %.6f\n", header.clockOffset);
+  cout << "Ticks:    " << header.ticks.written.load() << " written" << endl;
+  cout << "Messages: " << header.messages.written.load() << " written" << endl;
+  cout << "Frames:   " << header.frames.written.load() << " written" << endl;
+}
+
+static void printMessages(const vector<char>& file, const FlightRing& ring, uint64_t count)
+{
+  uint64_t first;
+  uint64_t valid = flightValidEntries(ring.written.load(), ring.capacity, &first);
+  uint64_t start = first + valid - min(count, valid);
+  cout << endl << "Last messages:" << endl;
+  cout << "  time\tsent\ttype\tserial\tsource\tlength" << endl;
+  for (uint64_t i = start; i < first + valid; i++) {
+    const FlightMessage& m = entryAt<FlightMessage>(file, ring, i);
+    printf("  %.6f\t%.6f\t%d\t%d\t%d\t%d\n", m.time, m.sentTime, m.msgType, m.serialNo, m.sourceModule, m.length);
+  }
+}
+
+static void printFrames(const vector<char>& file, const FlightRing& ring, uint64_t count)
+{
+  uint64_t first;
+  uint64_t valid = flightValidEntries(ring.written.load(), ring.capacity, &first);
+  uint64_t start = first + valid - min(count, valid);
+  cout << endl << "Last frames:" << endl;
+  cout << "  frame\ttick\ttime\tduration" << endl;
+  for (uint64_t i = start; i < first + valid; i++) {
+    const FlightFrame& f = entryAt<FlightFrame>(file, ring, i);
+    printf("  %llu\t%llu\t%.6f\t%.6f\n", (unsigned long long) f.frame, (unsigned long long) f.tick, f.time, f.duration);
+  }
+}
+
+static void printTicks(const vector<char>& file, const FlightRing& ring, uint64_t count)
+{
+  uint64_t first;
+  uint64_t valid = flightValidEntries(ring.written.load(), ring.capacity, &first);
+  uint64_t start = first + valid - min(count, valid);
+  cout << endl << "Last ticks:" << endl;
+  cout << "  tick\ttime\tduration\tpos\tforce" << endl;
+  for (uint64_t i = start; i < first + valid; i++) {
+    const FlightTick& t = entryAt<FlightTick>(file, ring, i);
+    printf("  %llu\t%.6f\t%.6f\t%.4f,%.4f,%.4f\t%.3f,%.3f,%.3f\n", (unsigned long long) t.tick, t.time,
+      t.duration, t.pos[0], t.pos[1], t.pos[2], t.force[0], t.force[1], t.force[2]);
+  }
+}
+
+/**
+ * Writes every complete entry of the three rings as CSV.
+ */
+static bool writeCsv(const vector<char>& file, const FlightHeader& header, const string& prefix)
+{
+  uint64_t first;
+  uint64_t valid;
+  FILE* out = fopen((prefix + "_ticks.csv").c_str(), "w");
+  if (out == NULL) {
+    cout << "Could not open " << prefix << "_ticks.csv for writing." << endl;
+    return false;
+  }
+  fprintf(out, "tick,time,duration,posX,posY,posZ,velX,velY,velZ,forceX,forceY,forceZ\n");
+  valid = flightValidEntries(header.ticks.written.load(), header.ticks.capacity, &first);
+  for (uint64_t i = first; i < first + valid; i++) {
+    const FlightTick& t = entryAt<FlightTick>(file, header.ticks, i);
+    fprintf(out, "%llu,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g\n",
+      (unsigned long long) t.tick, t.time, t.duration, t.pos[0], t.pos[1], t.pos[2],
+      t.vel[0], t.vel[1], t.vel[2], t.force[0], t.force[1], t.force[2]);
+  }
+  fclose(out);
+
+  out = fopen((prefix + "_messages.csv").c_str(), "w");
+  if (out == NULL) {
+    cout << "Could not open " << prefix << "_messages.csv for writing." << endl;
+    return false;
+  }
+  fprintf(out, "time,sentTime,msgType,serialNo,sourceModule,length,bytes\n");
+  valid = flightValidEntries(header.messages.written.load(), header.messages.capacity, &first);
+  for (uint64_t i = first; i < first + valid; i++) {
+    const FlightMessage& m = entryAt<FlightMessage>(file, header.messages, i);
+    fprintf(out, "%.17g,%.17g,%d,%d,%d,%d,", m.time, m.sentTime, m.msgType, m.serialNo, m.sourceModule, m.length);
+    int kept = min(m.length, FLIGHT_MESSAGE_BYTES);
+    for (int b = 0; b < kept; b++) {
+      fprintf(out, "%02x", m.bytes[b]);
+    }
+    fprintf(out, "\n");
+  }
+  fclose(out);
+
+  out = fopen((prefix + "_frames.csv").c_str(), "w");
+  if (out == NULL) {
+    cout << "Could not open " << prefix << "_frames.csv for writing." << endl;
+    return false;
+  }
+  fprintf(out, "frame,tick,time,duration\n");
+  valid = flightValidEntries(header.frames.written.load(), header.frames.capacity, &first);
+  for (uint64_t i = first; i < first + valid; i++) {
+    const FlightFrame& f = entryAt<FlightFrame>(file, header.frames, i);
+    fprintf(out, "%llu,%llu,%.17g,%.17g\n", (unsigned long long) f.frame, (unsigned long long) f.tick, f.time, f.duration);
+  }
+  fclose(out);
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    cout << "Usage: flightRecorderDump <file> [--count <n>] [--csv <prefix>]" << endl;
+    return 1;
+  }
+  string path = argv[1];
+  string csvPrefix;
+  uint64_t count = 20;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+      count = (uint64_t) max(0, atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+      csvPrefix = argv[++i];
+    }
+    else {
+      cout << "Unknown option " << argv[i] << endl;
+      return 1;
+    }
+  }
+
+  ifstream in(path.c_str(), ifstream::binary | ifstream::ate);
+  if (!in) {
+    cout << "Could not open " << path << "." << endl;
+    return 1;
+  }
+  size_t fileSize = (size_t) in.tellg();
+  vector<char> file(fileSize);
+  in.seekg(0);
+  in.read(file.data(), (streamsize) fileSize);
+  if (!in || fileSize < sizeof(FlightHeader) || memcmp(file.data(), FLIGHT_MAGIC, 8) != 0) {
+    cout << path << " is not a flight recorder file." << endl;
+    return 1;
+  }
+  const FlightHeader& header = *(const FlightHeader*) file.data();
+  if (header.version != FLIGHT_VERSION) {
+    cout << "Unsupported flight recorder version " << header.version << "." << endl;
+    return 1;
+  }
+  if (!checkRing(header.ticks, sizeof(FlightTick), fileSize, "tick")
+      || !checkRing(header.messages, sizeof(FlightMessage), fileSize, "message")
+      || !checkRing(header.frames, sizeof(FlightFrame), fileSize, "frame")) {
+    return 1;
+  }
+
+  printHeader(header);
+  printMessages(file, header.messages, count);
+  printFrames(file, header.frames, count);
+  printTicks(file, header.ticks, count);
+  if (!csvPrefix.empty() && !writeCsv(file, header, csvPrefix)) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,407 @@
+#include "RecordingReader.h"
+#include "recordingCodec.h"
+#include <iostream>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+RecordingReader::RecordingReader()
+{
+  base = NULL;
+  fileSize = 0;
+#ifdef _WIN32
+  fileHandle = INVALID_HANDLE_VALUE;
+  mapHandle = NULL;
+#else
+  fd = -1;
+#endif
+  rowCount = 0;
+  complete = false;
+  dataOffset = 0;
+}
+
+RecordingReader::~RecordingReader()
+{
+  close();
+}
+
+/**
+ * Maps the whole file read-only.
+ */
+bool RecordingReader::mapFile(const string& path)
+{
+#ifdef _WIN32
+  fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    cout << "Could not open " << path << " with error: " << GetLastError() << endl;
+    return false;
+  }
+  LARGE_INTEGER size;
+  GetFileSizeEx(fileHandle, &size);
+  fileSize = (size_t) size.QuadPart;
+  if (fileSize == 0) {
+    return true;
+  }
+  mapHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapHandle == NULL) {
+    cout << "Could not map " << path << " with error: " << GetLastError() << endl;
+    return false;
+  }
+  base = (const char*) MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+  fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    cout << "Could not open " << path << "." << endl;
+    return false;
+  }
+  struct stat st;
+  fstat(fd, &st);
+  fileSize = (size_t) st.st_size;
+  if (fileSize == 0) {
+    return true;
+  }
+  void* mapped = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    cout << "Could not map " << path << "." << endl;
+    return false;
+  }
+  madvise(mapped, fileSize, MADV_WILLNEED);
+  base = (const char*) mapped;
+#endif
+  return base != NULL;
+}
+
+/**
+ * @param path Recording file to open
+ *
+ * Maps the file and reads its header, schema and chunk index. Returns false if the file is not a
+ * recording or is damaged before the first chunk.
+ */
+bool RecordingReader::open(const string& path)
+{
+  close();
+  if (!mapFile(path)) {
+    close();
+    return false;
+  }
+  if (fileSize < sizeof(RecordingFileHeader)) {
+    cout << path << " is too short to be a recording." << endl;
+    close();
+    return false;
+  }
+  memcpy(&header, base, sizeof(header));
+  if (memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) != 0) {
+    cout << path << " is not a recording." << endl;
+    close();
+    return false;
+  }
+  if (header.version > RECORDING_VERSION) {
+    cout << path << " has version " << header.version << ", newer than this reader." << endl;
+    close();
+    return false;
+  }
+  dataOffset = sizeof(RecordingFileHeader) + (uint64_t) header.columnCount*sizeof(RecordingColumnSchema);
+  if (dataOffset > fileSize) {
+    cout << path << " has a truncated schema." << endl;
+    close();
+    return false;
+  }
+  const RecordingColumnSchema* schema = (const RecordingColumnSchema*) (base + sizeof(RecordingFileHeader));
+  columns.assign(schema, schema + header.columnCount);
+  for (size_t i = 0; i < columns.size(); i++) {
+    columns[i].name[RECORDING_COLUMN_NAME_LENGTH - 1] = '\0';
+  }
+
+  complete = readIndex();
+  if (!complete && !scanChunks()) {
+    close();
+    return false;
+  }
+  decodedBlocks.assign(chunks.size()*columns.size(), vector<uint64_t>());
+  decodeOnce.reset(new once_flag[chunks.size()*columns.size()]);
+  return true;
+}
+
+/**
+ * Unmaps the file. Spans obtained from this reader become invalid.
+ */
+void RecordingReader::close()
+{
+#ifdef _WIN32
+  if (base != NULL) {
+    UnmapViewOfFile(base);
+  }
+  if (mapHandle != NULL) {
+    CloseHandle(mapHandle);
+  }
+  if (fileHandle != INVALID_HANDLE_VALUE) {
+    CloseHandle(fileHandle);
+  }
+  mapHandle = NULL;
+  fileHandle = INVALID_HANDLE_VALUE;
+#else
+  if (base != NULL) {
+    munmap((void*) base, fileSize);
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  fd = -1;
+#endif
+  base = NULL;
+  fileSize = 0;
+  columns.clear();
+  chunks.clear();
+  markers.clear();
+  decodedBlocks.clear();
+  decodeOnce.reset();
+  rowCount = 0;
+  complete = false;
+}
+
+/**
+ * Checks that a well-formed chunk starts at offset and fits in the file, and returns its size.
+ */
+bool RecordingReader::checkChunk(uint64_t offset, uint64_t* chunkSize)
+{
+  uint64_t descriptors = sizeof(RecordingChunkHeader) + columns.size()*sizeof(RecordingColumnBlock);
+  if (offset % 8 != 0 || offset + descriptors > fileSize) {
+    return false;
+  }
+  const RecordingChunkHeader* chunkHeader = (const RecordingChunkHeader*) (base + offset);
+  if (chunkHeader->magic != RECORDING_CHUNK_MAGIC) {
+    return false;
+  }
+  const RecordingColumnBlock* blocks = (const RecordingColumnBlock*) (chunkHeader + 1);
+  uint64_t size = descriptors;
+  for (size_t c = 0; c < columns.size(); c++) {
+    size += recordingPad(blocks[c].length);
+  }
+  if (offset + size > fileSize) {
+    return false;
+  }
+  *chunkSize = size;
+  return true;
+}
+
+/**
+ * Reads the footer: the chunk index and, from version 2, the markers. Returns false if the trailer
+ * is missing or inconsistent.
+ */
+bool RecordingReader::readIndex()
+{
+  RecordingTrailer trailer;
+  memset(&trailer, 0, sizeof(trailer));
+  uint64_t trailerSize = (header.version < 2) ? sizeof(RecordingTrailerV1) : sizeof(RecordingTrailer);
+  if (fileSize < dataOffset + trailerSize) {
+    return false;
+  }
+  const char* trailerStart = base + fileSize - trailerSize;
+  if (header.version < 2) {
+    const RecordingTrailerV1* old = (const RecordingTrailerV1*) trailerStart;
+    trailer.indexOffset = old->indexOffset;
+    trailer.chunkCount = old->chunkCount;
+    trailer.rowCount = old->rowCount;
+    trailer.markerOffset = old->indexOffset + old->chunkCount*sizeof(RecordingChunkIndexEntry);
+    trailer.markerCount = 0;
+    memcpy(trailer.magic, old->magic, sizeof(trailer.magic));
+  }
+  else {
+    memcpy(&trailer, trailerStart, sizeof(trailer));
+  }
+  if (memcmp(trailer.magic, RECORDING_TRAILER_MAGIC, sizeof(trailer.magic)) != 0) {
+    return false;
+  }
+  uint64_t indexEnd = trailer.indexOffset + trailer.chunkCount*sizeof(RecordingChunkIndexEntry);
+  uint64_t markerEnd = trailer.markerOffset + trailer.markerCount*sizeof(RecordingMarker);
+  if (trailer.indexOffset < dataOffset || indexEnd != trailer.markerOffset || markerEnd != fileSize - trailerSize) {
+    return false;
+  }
+  const RecordingChunkIndexEntry* index = (const RecordingChunkIndexEntry*) (base + trailer.indexOffset);
+  chunks.assign(index, index + trailer.chunkCount);
+  for (size_t i = 0; i < chunks.size(); i++) {
+    uint64_t chunkSize;
+    if (!checkChunk(chunks[i].offset, &chunkSize)) {
+      chunks.clear();
+      return false;
+    }
+  }
+  const RecordingMarker* markerStart = (const RecordingMarker*) (base + trailer.markerOffset);
+  markers.assign(markerStart, markerStart + trailer.markerCount);
+  rowCount = trailer.rowCount;
+  return true;
+}
+
+/**
+ * Rebuilds the chunk index of a recording without a footer by walking the chunks from the start.
+ * Stops at the first damaged chunk.
+ */
+bool RecordingReader::scanChunks()
+{
+  chunks.clear();
+  rowCount = 0;
+  uint64_t offset = dataOffset;
+  uint64_t chunkSize;
+  while (checkChunk(offset, &chunkSize)) {
+    const RecordingChunkHeader* chunkHeader = (const RecordingChunkHeader*) (base + offset);
+    RecordingChunkIndexEntry entry;
+    entry.offset = offset;
+    entry.firstRow = rowCount;
+    entry.rowCount = chunkHeader->rowCount;
+    entry.reserved = 0;
+    chunks.push_back(entry);
+    rowCount += chunkHeader->rowCount;
+    offset += chunkSize;
+  }
+  cout << "Recording has no index, recovered " << chunks.size() << " chunks." << endl;
+  return true;
+}
+
+/**
+ * Returns true if the recording was closed cleanly and its footer index was used.
+ */
+bool RecordingReader::isComplete()
+{
+  return complete;
+}
+
+uint32_t RecordingReader::getVersion()
+{
+  return header.version;
+}
+
+/**
+ * Returns the time the recording was started, in seconds since the Unix epoch.
+ */
+double RecordingReader::getCreatedTime()
+{
+  return header.createdTime;
+}
+
+size_t RecordingReader::getColumnCount()
+{
+  return columns.size();
+}
+
+const RecordingColumnSchema& RecordingReader::getColumn(size_t column)
+{
+  return columns[column];
+}
+
+/**
+ * Returns the index of the column called name, or -1 if there is none.
+ */
+int RecordingReader::findColumn(const string& name)
+{
+  for (size_t i = 0; i < columns.size(); i++) {
+    if (name == columns[i].name) {
+      return (int) i;
+    }
+  }
+  return -1;
+}
+
+uint64_t RecordingReader::getRowCount()
+{
+  return rowCount;
+}
+
+size_t RecordingReader::getChunkCount()
+{
+  return chunks.size();
+}
+
+const RecordingChunkIndexEntry& RecordingReader::getChunk(size_t chunk)
+{
+  return chunks[chunk];
+}
+
+/**
+ * Returns the index of the chunk that holds row, or getChunkCount() if row is past the end.
+ */
+size_t RecordingReader::findChunk(uint64_t row)
+{
+  size_t low = 0;
+  size_t high = chunks.size();
+  while (low < high) {
+    size_t mid = (low + high)/2;
+    if (chunks[mid].firstRow + chunks[mid].rowCount <= row) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+size_t RecordingReader::getMarkerCount()
+{
+  return markers.size();
+}
+
+const RecordingMarker& RecordingReader::getMarker(size_t marker)
+{
+  return markers[marker];
+}
+
+/**
+ * Decodes a compressed block into decodedBlocks. The slot is left empty if the block is damaged or
+ * uses an unknown encoding.
+ */
+void RecordingReader::decodeBlock(size_t chunk, size_t column, const RecordingColumnBlock& block, const char* data)
+{
+  size_t rows = chunks[chunk].rowCount;
+  vector<uint64_t> values(rows);
+  bool ok = false;
+  if (columns[column].elementSize == sizeof(uint64_t) && block.encoding == RECORDING_ENCODING_XOR) {
+    ok = recordingDecodeXor((const uint8_t*) data, (size_t) block.length, values.data(), rows);
+  }
+  else if (columns[column].elementSize == sizeof(uint64_t) && block.encoding == RECORDING_ENCODING_DELTA2) {
+    ok = recordingDecodeDelta2((const uint8_t*) data, (size_t) block.length, values.data(), rows);
+  }
+  if (ok) {
+    decodedBlocks[chunk*columns.size() + column].swap(values);
+  }
+  else {
+    cout << "Could not decode column " << columns[column].name << " of chunk " << chunk << "." << endl;
+  }
+}
+
+/**
+ * @param chunk Index of the chunk
+ * @param column Index of the column
+ * @param length Set to the size of the decoded block in bytes
+ *
+ * Returns a pointer to the values of the column block: into the mapped file for a raw block, or
+ * into a decoded copy for a compressed one. Returns NULL if the chunk or column does not exist or
+ * the block cannot be decoded.
+ */
+const void* RecordingReader::getColumnData(size_t chunk, size_t column, uint64_t* length)
+{
+  if (chunk >= chunks.size() || column >= columns.size()) {
+    return NULL;
+  }
+  const char* chunkStart = base + chunks[chunk].offset;
+  const RecordingColumnBlock* blocks = (const RecordingColumnBlock*) (chunkStart + sizeof(RecordingChunkHeader));
+  const char* data = (const char*) (blocks + columns.size());
+  for (size_t c = 0; c < column; c++) {
+    data += recordingPad(blocks[c].length);
+  }
+  if (blocks[column].encoding == RECORDING_ENCODING_RAW) {
+    *length = blocks[column].length;
+    return data;
+  }
+  size_t slot = chunk*columns.size() + column;
+  call_once(decodeOnce[slot], &RecordingReader::decodeBlock, this, chunk, column, blocks[column], data);
+  if (decodedBlocks[slot].empty()) {
+    return NULL;
+  }
+  *length = decodedBlocks[slot].size()*sizeof(uint64_t);
+  return decodedBlocks[slot].data();
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#ifndef _RECORDINGREADER_H_
+#define _RECORDINGREADER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+#include "recordingFormat.h"
+
+using namespace std;
+
+/**
+ * A read-only view of the values of one column within one chunk. The data points into the memory
+ * mapped file, or into the reader's copy of a decoded block, so it is only valid while the
+ * RecordingReader that produced it stays open.
+ */
+template <typename T>
+struct ColumnSpan
+{
+  const T* data;
+  size_t size;
+
+  const T& operator[](size_t i) const { return data[i]; }
+  const T* begin() const { return data; }
+  const T* end() const { return data + size; }
+};
+
+/**
+ * RecordingReader memory-maps a recording written by HapticEnvironment (see recordingFormat.h) and
+ * gives direct access to its column blocks. Nothing is copied: a ColumnSpan points straight into
+ * the mapping, so chunks can be processed in parallel from several threads once the file is open.
+ * Compressed blocks are decoded the first time they are asked for and kept until the reader is
+ * closed; that is also safe from several threads.
+ *
+ * If the recording was not closed cleanly, the footer is missing. The reader then rebuilds the
+ * chunk index by walking the chunks, isComplete returns false and no markers are available.
+ */
+class RecordingReader
+{
+  private:
+    const char* base;
+    size_t fileSize;
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mapHandle;
+#else
+    int fd;
+#endif
+    RecordingFileHeader header;
+    vector<RecordingColumnSchema> columns;
+    vector<RecordingChunkIndexEntry> chunks;
+    vector<RecordingMarker> markers;
+    uint64_t rowCount;
+    bool complete;
+    uint64_t dataOffset; // file offset of the first chunk
+    vector<vector<uint64_t>> decodedBlocks; // indexed by chunk*columnCount + column
+    unique_ptr<once_flag[]> decodeOnce;
+    bool mapFile(const string& path);
+    bool readIndex();
+    bool scanChunks();
+    bool checkChunk(uint64_t offset, uint64_t* chunkSize);
+    void decodeBlock(size_t chunk, size_t column, const RecordingColumnBlock& block, const char* data);
+
+  public:
+    RecordingReader();
+    ~RecordingReader();
+    bool open(const string& path);
+    void close();
+    bool isComplete();
+    uint32_t getVersion();
+    double getCreatedTime();
+    size_t getColumnCount();
+    const RecordingColumnSchema& getColumn(size_t column);
+    int findColumn(const string& name);
+    uint64_t getRowCount();
+    size_t getChunkCount();
+    const RecordingChunkIndexEntry& getChunk(size_t chunk);
+    size_t findChunk(uint64_t row);
+    size_t getMarkerCount();
+    const RecordingMarker& getMarker(size_t marker);
+    const void* getColumnData(size_t chunk, size_t column, uint64_t* length);
+
+    /**
+     * Returns the values of one column in one chunk. T must match the column's element size.
+     * Returns an empty span if the chunk or column does not exist.
+     */
+    template <typename T>
+    ColumnSpan<T> getColumnSpan(size_t chunk, size_t column)
+    {
+      ColumnSpan<T> span = {NULL, 0};
+      uint64_t length = 0;
+      const void* data = getColumnData(chunk, column, &length);
+      if (data == NULL || columns[column].elementSize != sizeof(T)) {
+        return span;
+      }
+      span.data = (const T*) data;
+      span.size = (size_t) (length/sizeof(T));
+      return span;
+    }
+};
+
+#endif
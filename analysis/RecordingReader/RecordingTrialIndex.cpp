@@ -0,0 +1,69 @@
+#include "RecordingTrialIndex.h"
+#include <fstream>
+#include <iostream>
+#include <string.h>
+
+/**
+ * @param recordingPath Path of the first segment of the session, as given in START_RECORDING
+ *
+ * Reads the trial index of the session. Returns false if there is none or it is damaged. A trial
+ * that was still being written when the index was cut off is ignored.
+ */
+bool RecordingTrialIndex::open(const string& recordingPath)
+{
+  sessionBase = recordingPath;
+  trials.clear();
+  trialPositions.clear();
+  string path = recordingTrialIndexPath(recordingPath);
+  ifstream in(path.c_str(), ifstream::binary);
+  if (!in) {
+    cout << "No trial index at " << path << "." << endl;
+    return false;
+  }
+  RecordingTrialIndexHeader header;
+  in.read((char*) &header, sizeof(header));
+  if (!in || memcmp(header.magic, RECORDING_TRIAL_INDEX_MAGIC, sizeof(header.magic)) != 0
+    || header.entrySize < sizeof(RecordingTrialEntry)) {
+    cout << path << " is not a trial index." << endl;
+    return false;
+  }
+  vector<char> entry(header.entrySize);
+  while (in.read(&entry[0], header.entrySize)) {
+    RecordingTrialEntry trial;
+    memcpy(&trial, &entry[0], sizeof(trial));
+    trialPositions[trial.trialNum] = trials.size();
+    trials.push_back(trial);
+  }
+  return true;
+}
+
+size_t RecordingTrialIndex::getTrialCount()
+{
+  return trials.size();
+}
+
+const RecordingTrialEntry& RecordingTrialIndex::getTrial(size_t position)
+{
+  return trials[position];
+}
+
+/**
+ * Returns the position of the trial numbered trialNum, or -1 if it is not in the index. If a trial
+ * number was repeated, the last one is returned.
+ */
+int RecordingTrialIndex::findTrial(int trialNum)
+{
+  unordered_map<int, size_t>::iterator it = trialPositions.find(trialNum);
+  if (it == trialPositions.end()) {
+    return -1;
+  }
+  return (int) it->second;
+}
+
+/**
+ * Returns the path of one segment of the session.
+ */
+string RecordingTrialIndex::getSegmentPath(uint32_t segment)
+{
+  return recordingSegmentPath(sessionBase, segment);
+}
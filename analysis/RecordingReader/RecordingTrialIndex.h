@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef _RECORDINGTRIALINDEX_H_
+#define _RECORDINGTRIALINDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "recordingFormat.h"
+
+using namespace std;
+
+/**
+ * RecordingTrialIndex reads the trial index written next to a recording session (see
+ * recordingFormat.h). Each trial can be looked up by number in constant time. The entry gives the
+ * segment file and row range to open with RecordingReader, so nothing else in the session has to be
+ * read.
+ */
+class RecordingTrialIndex
+{
+  private:
+    string sessionBase;
+    vector<RecordingTrialEntry> trials;
+    unordered_map<int, size_t> trialPositions; // trial number to position in trials
+
+  public:
+    bool open(const string& recordingPath);
+    size_t getTrialCount();
+    const RecordingTrialEntry& getTrial(size_t position);
+    int findTrial(int trialNum);
+    string getSegmentPath(uint32_t segment);
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "RecordingReader.h"
+#include "RecordingTrialIndex.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+/**
+ * @file main.cpp
+ * @brief Command-line converter for HapticEnvironment recordings.
+ *
+ * Usage: recordingReader <recording> [--info] [--trials] [--csv <file>] [--columns <directory>] [--threads <n>]
+ *
+ * --info prints the schema and size of the recording. --csv writes every row as comma-separated
+ * text. --columns writes one raw little-endian file per column (<name>.bin), which NumPy loads with
+ * numpy.fromfile(path, dtype="<f8") or dtype="<i8" for the tick column. Both conversions run on
+ * several threads: CSV formatting is split by chunk, column files are split by column. --trials
+ * lists the trials of the session from its trial index, with the segment and rows of each.
+ */
+
+#define CSV_BATCH_CHUNKS 8 // chunks formatted per thread before the batch is written out
+
+/**
+ * Formats the rows of one chunk as CSV lines.
+ */
+static void formatChunk(RecordingReader* reader, size_t chunk, string* out)
+{
+  size_t columnCount = reader->getColumnCount();
+  size_t rows = reader->getChunk(chunk).rowCount;
+  vector<const char*> data(columnCount);
+  for (size_t c = 0; c < columnCount; c++) {
+    uint64_t length = 0;
+    data[c] = (const char*) reader->getColumnData(chunk, c, &length);
+    if (data[c] == NULL || length < rows*reader->getColumn(c).elementSize) {
+      data[c] = NULL;
+    }
+  }
+  out->clear();
+  out->reserve(rows*columnCount*20);
+  char field[64];
+  for (size_t r = 0; r < rows; r++) {
+    for (size_t c = 0; c < columnCount; c++) {
+      int n = 0;
+      if (data[c] != NULL && reader->getColumn(c).type == RECORDING_TYPE_INT64) {
+        int64_t value;
+        memcpy(&value, data[c] + r*sizeof(value), sizeof(value));
+        n = snprintf(field, sizeof(field), "%lld", (long long) value);
+      }
+      else if (data[c] != NULL && reader->getColumn(c).type == RECORDING_TYPE_FLOAT64) {
+        double value;
+        memcpy(&value, data[c] + r*sizeof(value), sizeof(value));
+        n = snprintf(field, sizeof(field), "%.17g", value);
+      }
+      out->append(field, n);
+      out->push_back(c + 1 < columnCount ? ',' : '\n');
+    }
+  }
+}
+
+/**
+ * Writes the recording as CSV, formatting chunks on several threads and writing them in order.
+ */
+static bool writeCsv(RecordingReader& reader, const string& path, unsigned threads)
+{
+  ofstream out(path.c_str(), ofstream::binary);
+  if (!out) {
+    cout << "Could not open " << path << " for writing." << endl;
+    return false;
+  }
+  for (size_t c = 0; c < reader.getColumnCount(); c++) {
+    out << reader.getColumn(c).name << (c + 1 < reader.getColumnCount() ? "," : "\n");
+  }
+  size_t chunkCount = reader.getChunkCount();
+  size_t batchSize = threads*CSV_BATCH_CHUNKS;
+  vector<string> formatted(batchSize);
+  for (size_t first = 0; first < chunkCount; first += batchSize) {
+    size_t count = min(batchSize, chunkCount - first);
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+      workers.push_back(thread([&, t]() {
+        for (size_t i = t; i < count; i += threads) {
+          formatChunk(&reader, first + i, &formatted[i]);
+        }
+      }));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+      workers[t].join();
+    }
+    for (size_t i = 0; i < count; i++) {
+      out.write(formatted[i].data(), formatted[i].size());
+    }
+  }
+  return (bool) out;
+}
+
+/**
+ * Writes each column to <directory>/<name>.bin, one column per thread at a time.
+ */
+static bool writeColumns(RecordingReader& reader, const string& directory, unsigned threads)
+{
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  size_t columnCount = reader.getColumnCount();
+  vector<int> failed(columnCount, 0);
+  vector<thread> workers;
+  for (unsigned t = 0; t < threads; t++) {
+    workers.push_back(thread([&, t]() {
+      for (size_t c = t; c < columnCount; c += threads) {
+        string path = directory + "/" + reader.getColumn(c).name + ".bin";
+        ofstream out(path.c_str(), ofstream::binary);
+        for (size_t chunk = 0; chunk < reader.getChunkCount() && out; chunk++) {
+          uint64_t length = 0;
+          const char* data = (const char*) reader.getColumnData(chunk, c, &length);
+          if (data == NULL) {
+            failed[c] = 1;
+            break;
+          }
+          out.write(data, (streamsize) length);
+        }
+        if (!out) {
+          failed[c] = 1;
+        }
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+  bool ok = true;
+  for (size_t c = 0; c < columnCount; c++) {
+    if (failed[c]) {
+      cout << "Could not write column " << reader.getColumn(c).name << "." << endl;
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+static void printInfo(RecordingReader& reader)
+{
+  cout << "Version:  " << reader.getVersion() << endl;
+  cout << "Rows:     " << reader.getRowCount() << endl;
+  cout << "Chunks:   " << reader.getChunkCount() << endl;
+  cout << "Markers:  " << reader.getMarkerCount() << endl;
+  cout << "Complete: " << (reader.isComplete() ? "yes" : "no (index rebuilt)") << endl;
+  cout << "Columns:" << endl;
+  for (size_t c = 0; c < reader.getColumnCount(); c++) {
+    const RecordingColumnSchema& column = reader.getColumn(c);
+    cout << "  " << column.name << "\t" << (column.type == RECORDING_TYPE_INT64 ? "int64" : "float64") << endl;
+  }
+}
+
+/**
+ * Prints the trial index of the session that recording belongs to.
+ */
+static bool printTrials(const string& path)
+{
+  RecordingTrialIndex index;
+  if (!index.open(path)) {
+    return false;
+  }
+  cout << index.getTrialCount() << " trials" << endl;
+  cout << "  trial\tsegment\trows\tduration\tcomplete" << endl;
+  for (size_t i = 0; i < index.getTrialCount(); i++) {
+    const RecordingTrialEntry& trial = index.getTrial(i);
+    cout << "  " << trial.trialNum << "\t" << trial.startSegment;
+    if (trial.endSegment != trial.startSegment) {
+      cout << "-" << trial.endSegment;
+    }
+    cout << "\t" << trial.startRow << "-" << trial.endRow << "\t" << (trial.endTime - trial.startTime)
+      << "\t" << ((trial.flags & RECORDING_TRIAL_COMPLETE) ? "yes" : "no") << endl;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    cout << "Usage: recordingReader <recording> [--info] [--trials] [--csv <file>] [--columns <directory>] [--threads <n>]" << endl;
+    return 1;
+  }
+  string path = argv[1];
+  string csvPath;
+  string columnDir;
+  bool info = false;
+  bool trials = false;
+  unsigned threads = max(1u, thread::hardware_concurrency());
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--info") == 0) {
+      info = true;
+    }
+    else if (strcmp(argv[i], "--trials") == 0) {
+      trials = true;
+    }
+    else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+      csvPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--columns") == 0 && i + 1 < argc) {
+      columnDir = argv[++i];
+    }
+    else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = max(1, atoi(argv[++i]));
+    }
+    else {
+      cout << "Unknown option " << argv[i] << endl;
+      return 1;
+    }
+  }
+  if (csvPath.empty() && columnDir.empty() && !trials) {
+    info = true;
+  }
+  if (trials && !printTrials(path)) {
+    return 1;
+  }
+  if (!info && csvPath.empty() && columnDir.empty()) {
+    return 0;
+  }
+
+  RecordingReader reader;
+  if (!reader.open(path)) {
+    return 1;
+  }
+  if (info) {
+    printInfo(reader);
+  }
+  if (!csvPath.empty() && !writeCsv(reader, csvPath, threads)) {
+    return 1;
+  }
+  if (!columnDir.empty() && !writeColumns(reader, columnDir, threads)) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#ifndef _FLIGHTRECORDERFORMAT_H_
+#define _FLIGHTRECORDERFORMAT_H_
+
+/**
+ * @file flightRecorderFormat.h
+ * @brief Layout of the flight recorder file
+ *
+ * The flight recorder is a fixed-size file that HapticEnvironment maps into memory for the whole
+ * run:
+ *
+ *   FlightHeader
+ *   FlightTick[FLIGHT_TICK_ENTRIES]
+ *   FlightMessage[FLIGHT_MESSAGE_ENTRIES]
+ *   FlightFrame[FLIGHT_FRAME_ENTRIES]
+ *
+ * Each ring is written by a single thread: ticks by the haptic thread, messages by the listener
+ * and frames by the graphics thread. The writer fills entry (written % capacity) and only then
+ * increments written, so entries older than written are complete. Once a ring has wrapped, the
+ * entry at written % capacity may have been half overwritten when the program stopped, so the
+ * valid entries are the last capacity - 1.
+ *
+ * The file is a shared mapping, so everything stored before a crash is in the operating system's
+ * page cache and reaches the disk without any help from the crashed process. It does not survive
+ * a power failure or a kernel crash. All values are little-endian; times are on the getSteadyTime
+ * clock, and clockOffset converts them to MessageHandler's clock.
+ */
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+#define FLIGHT_MAGIC "HEFLIGHT"
+#define FLIGHT_VERSION 2
+#define FLIGHT_DEFAULT_FILE "flightRecorder.bin"
+#define FLIGHT_TICK_ENTRIES 65536 // 16 s at 4 kHz, 65 s at 1 kHz
+#define FLIGHT_MESSAGE_ENTRIES 4096
+#define FLIGHT_FRAME_ENTRIES 4096 // about a minute at 60 Hz
+#define FLIGHT_MESSAGE_BYTES 96 // leading bytes of each packet that are kept, header included
+
+#define FLIGHT_STATE_RUNNING 1
+#define FLIGHT_STATE_CLOSED 2 // the program exited normally
+#define FLIGHT_STATE_CRASHED 3 // a fatal signal was caught
+
+/**
+ * Haptic tool state at the end of one tick. duration is the time the tick's work took.
+ */
+struct FlightTick
+{
+  uint64_t tick;
+  double time;
+  double duration;
+  double pos[3];
+  double vel[3];
+  double force[3];
+};
+
+/**
+ * A packet as read by the listener.
+ */
+struct FlightMessage
+{
+  double time; // when the listener read it
+  double sentTime; // header timestamp, on MessageHandler's clock
+  int32_t msgType;
+  int32_t serialNo;
+  int32_t sourceModule;
+  int32_t length; // full length of the packet
+  uint8_t bytes[FLIGHT_MESSAGE_BYTES];
+};
+
+/**
+ * One iteration of the graphics loop. duration covers rendering and the buffer swap.
+ */
+struct FlightFrame
+{
+  uint64_t frame;
+  uint64_t tick; // haptic tick whose tool state the frame rendered
+  double time;
+  double duration;
+};
+
+struct FlightRing
+{
+  std::atomic<uint64_t> written; // entries written since the file was opened
+  uint32_t entrySize;
+  uint32_t capacity;
+  uint64_t offset; // from the start of the file
+};
+
+struct FlightHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t state; // FLIGHT_STATE_*
+  int32_t signal; // signal that stopped the program, when CRASHED
+  int32_t pid;
+  int64_t startTime; // seconds since the Unix epoch at which the file was opened
+  double stopTime; // getSteadyTime at the crash or the close
+  double clockOffset; // add to a time to put it on MessageHandler's clock
+  FlightRing ticks;
+  FlightRing messages;
+  FlightRing frames;
+};
+
+#define FLIGHT_HEADER_SIZE 4096 // the rings start on the next page
+#define FLIGHT_TICKS_OFFSET FLIGHT_HEADER_SIZE
+#define FLIGHT_MESSAGES_OFFSET (FLIGHT_TICKS_OFFSET + FLIGHT_TICK_ENTRIES*sizeof(FlightTick))
+#define FLIGHT_FRAMES_OFFSET (FLIGHT_MESSAGES_OFFSET + FLIGHT_MESSAGE_ENTRIES*sizeof(FlightMessage))
+#define FLIGHT_FILE_SIZE (FLIGHT_FRAMES_OFFSET + FLIGHT_FRAME_ENTRIES*sizeof(FlightFrame))
+
+/**
+ * @param written The ring's written count
+ * @param capacity The ring's capacity
+ * @param first Set to the index of the oldest entry that is known to be complete
+ *
+ * Returns the number of complete entries. Entry i is at position i % capacity.
+ */
+inline uint64_t flightValidEntries(uint64_t written, uint32_t capacity, uint64_t* first)
+{
+  *first = (written >= capacity) ? written - capacity + 1 : 0;
+  return written - *first;
+}
+
+/**
+ * Name the previous file is moved to when a new run finds that it did not close normally.
+ */
+inline std::string flightPreviousPath(const std::string& path)
+{
+  return path + ".prev";
+}
+
+#endif
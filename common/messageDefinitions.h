@@ -1,3 +1,8 @@
+#pragma once
+
+#ifndef _MESSAGEDEFINITIONS_H_
+#define _MESSAGEDEFINITIONS_H_
+
 #define DEFAULT_IP "localhost:10000"
 #define MAX_PACKET_LENGTH 8192 // arbitrary 
 #define MAX_STRING_LENGTH 128  // also arbitrary
@@ -18,6 +23,7 @@
 #define PAUSE_RECORDING 9
 #define RESUME_RECORDING 10
 #define RESET_WORLD 11
+#define DUMP_TRACE 12
 
 // Combined/Complex Object Messages 500-1000
 #define CST_CREATE 500
@@ -44,6 +50,7 @@
 #define HAPTICS_VISCOSITY_FIELD 1011
 #define HAPTICS_FREEZE_EFFECT 1012
 #define HAPTICS_REMOVE_WORLD_EFFECT 1013
+#define HAPTICS_SET_STREAM_RATE 1014
 
 // Graphics Messages are 2000-3000 
 #define GRAPHICS_SET_ENABLED 2000
@@ -63,7 +70,8 @@
 typedef struct {
   int serial_no; /**< Serial Number of message, received from MessageHandler.*/
   int msg_type; /**< Type of message should correspond to one of the integers listed in messageDefinitions.h.*/
-  double reserved; /**< Reserved for now */
+  int source_module; /**< Module number of the sender, stamped by MessageHandler. 0 if unstamped.*/
+  int source_seq; /**< Sequence number per sender and msg_type on the route to this receiver, stamped by MessageHandler.*/
   double timestamp; /**< Time MessageHandler made the message.*/ 
 } MSG_HEADER;
 
@@ -120,6 +128,11 @@ typedef struct {
   MSG_HEADER header;
 } M_RESUME_RECORDING;
 
+typedef struct {
+  MSG_HEADER header;
+  char filename[MAX_STRING_LENGTH]; /**< Trace file to write, or empty for the default.*/
+} M_DUMP_TRACE;
+
 typedef struct {
   MSG_HEADER header;
 } M_RESET_WORLD;
@@ -215,6 +228,8 @@ typedef struct {
   double forceY;
   double forceZ;
   char collisions[4][MAX_STRING_LENGTH]; // 4 object collisions at a time
+  long long tick; /**< Index of the haptic tick this sample was taken from. Gaps mean missed ticks, repeats mean duplicates.*/
+  double sampleTime; /**< Time of that haptic tick, on the MessageHandler clock.*/
 } M_HAPTIC_DATA_STREAM;
 
 typedef struct {
@@ -264,6 +279,11 @@ typedef struct {
   char effectName[MAX_STRING_LENGTH];
 } M_HAPTICS_REMOVE_WORLD_EFFECT;
 
+typedef struct {
+  MSG_HEADER header;
+  double rate; /**< Haptic data stream rate in Hz, clamped to 100-4000.*/
+} M_HAPTICS_SET_STREAM_RATE;
+
 typedef struct {
   MSG_HEADER header;
   char objectName[MAX_STRING_LENGTH];
@@ -343,3 +363,5 @@ typedef struct {
   double localPosition[3];
   float color[4];
 } M_GRAPHICS_SHAPE_TORUS;
+
+#endif
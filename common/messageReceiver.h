@@ -0,0 +1,259 @@
+#pragma once
+
+#ifndef _MESSAGERECEIVER_H_
+#define _MESSAGERECEIVER_H_
+
+/**
+ * @file messageReceiver.h
+ * @brief Helpers for modules that receive packets from MessageHandler.
+ *
+ * MessageHandler stamps every routed packet with the sending module and a sequence number per
+ * sender and msg_type (MSG_HEADER::source_module and MSG_HEADER::source_seq). SequenceTracker uses
+ * those stamps to count lost, duplicated and reordered packets per source. The socket helpers turn
+ * on the kernel's receive-buffer overflow counter and size the receive buffer, so that loss in the
+ * kernel can be told apart from loss on the network or in MessageHandler.
+ *
+ * Include messageDefinitions.h before this file.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/socket.h>
+    #include <sys/uio.h>
+#endif
+
+#define SEQUENCE_WINDOW 64 // how far back a late packet can still be matched against a gap
+#define SEQUENCE_RESET_DISTANCE 100000 // a jump back this large means the sender restarted
+
+/**
+ * Counters for one source. lost counts sequence numbers that were skipped and have not arrived
+ * since. A packet that fills an earlier gap is counted as reordered and removed from lost.
+ */
+struct SequenceStats
+{
+  int sourceModule;
+  int msgType;
+  uint64_t received;
+  uint64_t lost;
+  uint64_t duplicate;
+  uint64_t reordered;
+  uint64_t resets;
+};
+
+/**
+ * Tracks MessageHandler sequence numbers for every (source module, msg_type) pair seen. Safe to
+ * read from another thread while the receiving thread calls observe.
+ */
+class SequenceTracker
+{
+  private:
+    struct SourceState
+    {
+      int highest;
+      uint64_t window; // bit i is set if sequence number (highest - i) has been received
+      SequenceStats stats;
+    };
+    std::map<std::pair<int, int>, SourceState> sources;
+    std::mutex lock;
+
+  public:
+    /**
+     * Records one received packet. Packets with a source_module of 0 were not stamped by
+     * MessageHandler and are ignored.
+     */
+    void observe(const MSG_HEADER& header)
+    {
+      if (header.source_module == 0) {
+        return;
+      }
+      std::lock_guard<std::mutex> guard(lock);
+      std::pair<int, int> key(header.source_module, header.msg_type);
+      std::map<std::pair<int, int>, SourceState>::iterator it = sources.find(key);
+      if (it == sources.end()) {
+        SourceState state;
+        memset(&state, 0, sizeof(state));
+        state.highest = header.source_seq;
+        state.window = 1;
+        state.stats.sourceModule = header.source_module;
+        state.stats.msgType = header.msg_type;
+        state.stats.received = 1;
+        sources[key] = state;
+        return;
+      }
+      SourceState& state = it->second;
+      SequenceStats& stats = state.stats;
+      stats.received++;
+      int seq = header.source_seq;
+      if (seq > state.highest) {
+        int64_t distance = (int64_t) seq - state.highest;
+        stats.lost += distance - 1;
+        state.window = (distance >= SEQUENCE_WINDOW) ? 1 : ((state.window << distance) | 1);
+        state.highest = seq;
+        return;
+      }
+      int64_t distance = (int64_t) state.highest - seq;
+      if (distance >= SEQUENCE_RESET_DISTANCE) {
+        stats.resets++;
+        state.highest = seq;
+        state.window = 1;
+        return;
+      }
+      if (distance >= SEQUENCE_WINDOW) {
+        stats.reordered++;
+        if (stats.lost > 0) {
+          stats.lost--;
+        }
+        return;
+      }
+      uint64_t bit = ((uint64_t) 1) << distance;
+      if (state.window & bit) {
+        stats.duplicate++;
+        return;
+      }
+      state.window |= bit;
+      stats.reordered++;
+      if (stats.lost > 0) {
+        stats.lost--;
+      }
+    }
+
+    /**
+     * Returns the counters of every source seen so far.
+     */
+    std::vector<SequenceStats> getStats()
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      std::vector<SequenceStats> result;
+      for (std::map<std::pair<int, int>, SourceState>::iterator it = sources.begin(); it != sources.end(); ++it) {
+        result.push_back(it->second.stats);
+      }
+      return result;
+    }
+
+    /**
+     * Returns the counters of all sources added together. sourceModule and msgType are 0.
+     */
+    SequenceStats getTotals()
+    {
+      SequenceStats totals;
+      memset(&totals, 0, sizeof(totals));
+      std::vector<SequenceStats> all = getStats();
+      for (size_t i = 0; i < all.size(); i++) {
+        totals.received += all[i].received;
+        totals.lost += all[i].lost;
+        totals.duplicate += all[i].duplicate;
+        totals.reordered += all[i].reordered;
+        totals.resets += all[i].resets;
+      }
+      return totals;
+    }
+
+    void reset()
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      sources.clear();
+    }
+};
+
+/**
+ * Asks the kernel to report how many packets it dropped on this socket because the receive buffer
+ * was full. Returns false where SO_RXQ_OVFL is not supported.
+ */
+inline bool enableOverflowCounter(int sock)
+{
+#ifdef SO_RXQ_OVFL
+  int opt = 1;
+  return setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt)) == 0;
+#else
+  (void) sock;
+  return false;
+#endif
+}
+
+/**
+ * Returns the current size of the socket receive buffer in bytes, as reported by the kernel.
+ */
+inline int getReceiveBufferSize(int sock)
+{
+  int size = 0;
+  socklen_t len = sizeof(size);
+  if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char*) &size, &len) < 0) {
+    return -1;
+  }
+  return size;
+}
+
+/**
+ * @param sock Socket to resize
+ * @param packetsPerSecond Highest expected packet rate
+ * @param packetSize Typical packet size in bytes
+ * @param burstSeconds How long the receiver may stall without the kernel dropping packets
+ *
+ * Grows the receive buffer to hold burstSeconds of traffic. The kernel may cap the request
+ * (net.core.rmem_max on Linux), so the size actually granted is returned. The buffer is never made
+ * smaller than it already is.
+ */
+inline int autoSizeReceiveBuffer(int sock, double packetsPerSecond, int packetSize, double burstSeconds)
+{
+  int current = getReceiveBufferSize(sock);
+  int target = (int) (packetsPerSecond * packetSize * burstSeconds);
+  if (target <= current) {
+    return current;
+  }
+#ifdef SO_RCVBUFFORCE
+  if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &target, sizeof(target)) == 0) {
+    return getReceiveBufferSize(sock);
+  }
+#endif
+  setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*) &target, sizeof(target));
+  return getReceiveBufferSize(sock);
+}
+
+/**
+ * @param sock Socket to read from
+ * @param packet Buffer for the packet
+ * @param maxLength Size of the buffer
+ * @param overflowCount Set to the kernel's count of packets dropped on this socket, if the socket
+ * has the overflow counter enabled and the kernel reported it. Left unchanged otherwise.
+ *
+ * Receives one packet. Returns the number of bytes read, or a negative value on error.
+ */
+inline int receivePacket(int sock, char* packet, int maxLength, uint32_t* overflowCount)
+{
+#if defined(_WIN32) || !defined(SO_RXQ_OVFL)
+  (void) overflowCount;
+  return recv(sock, packet, maxLength, 0);
+#else
+  struct iovec iov;
+  iov.iov_base = packet;
+  iov.iov_len = maxLength;
+  char control[CMSG_SPACE(sizeof(uint32_t))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  int bytesRead = recvmsg(sock, &msg, 0);
+  if (bytesRead < 0) {
+    return bytesRead;
+  }
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+      memcpy(overflowCount, CMSG_DATA(cmsg), sizeof(uint32_t));
+    }
+  }
+  return bytesRead;
+#endif
+}
+
+#endif
@@ -3,10 +3,17 @@
 #ifndef _PLATFORM_COMPAT_H_
 #define _PLATFORM_COMPAT_H_
 
+#include <stdlib.h>
+#include <stddef.h>
+
 #ifdef _WIN32
     #include <winsock2.h>  // Must come before windows.h
     #include <ws2tcpip.h>
     #include <windows.h>
+    #include <io.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <malloc.h>
 
 namespace platform {
     // Sleep functions compatibility
@@ -45,6 +52,100 @@ namespace platform {
     inline int bind(SOCKET s, const struct sockaddr* name, int namelen) {
         return ::bind(s, name, namelen);
     }
+
+    // File output for the recorder - binary, truncating, returns -1 on failure
+    inline int openFileForWrite(const char* path) {
+        return ::_open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+    }
+
+    inline long long writeFile(int fd, const void* data, size_t length) {
+        return ::_write(fd, data, (unsigned int) length);
+    }
+
+    inline int syncFile(int fd) {
+        return ::_commit(fd);
+    }
+
+    inline int closeFile(int fd) {
+        return ::_close(fd);
+    }
+
+    // Reserves disk space for a file without changing its size
+    inline int preallocateFile(int fd, long long length) {
+        FILE_ALLOCATION_INFO info;
+        info.AllocationSize.QuadPart = length;
+        HANDLE handle = (HANDLE) ::_get_osfhandle(fd);
+        return ::SetFileInformationByHandle(handle, FileAllocationInfo, &info, sizeof(info)) ? 0 : -1;
+    }
+
+    // Sets the file size, releasing space reserved beyond it
+    inline int truncateFile(int fd, long long length) {
+        return ::_chsize_s(fd, length) == 0 ? 0 : -1;
+    }
+
+    // Aligned allocation for I/O buffers
+    inline void* alignedAlloc(size_t alignment, size_t size) {
+        return ::_aligned_malloc(size, alignment);
+    }
+
+    inline void alignedFree(void* ptr) {
+        ::_aligned_free(ptr);
+    }
+
+    // Named shared memory, created or opened for writing. Returns NULL on failure.
+    inline void* createSharedMemory(const char* name, size_t size) {
+        HANDLE mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD) size, name);
+        if (mapping == NULL) {
+            return NULL;
+        }
+        void* view = ::MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        ::CloseHandle(mapping); // the view keeps the mapping alive
+        return view;
+    }
+
+    // Maps existing named shared memory read-only. Returns NULL if it does not exist.
+    inline const void* openSharedMemory(const char* name, size_t size) {
+        HANDLE mapping = ::OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+        if (mapping == NULL) {
+            return NULL;
+        }
+        const void* view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+        ::CloseHandle(mapping);
+        return view;
+    }
+
+    // Unmaps shared memory. The creator also removes the name where the platform needs it.
+    inline void closeSharedMemory(const void* ptr, size_t size, const char* unlinkName) {
+        (void) size;
+        (void) unlinkName;
+        ::UnmapViewOfFile(ptr);
+    }
+
+    // Creates or truncates a file of the given size and maps it for writing. Stores go to the
+    // file through the page cache. Returns NULL on failure.
+    inline void* mapFileForWrite(const char* path, size_t size) {
+        HANDLE file = ::CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return NULL;
+        }
+        HANDLE mapping = ::CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD) ((unsigned long long) size >> 32), (DWORD) size, NULL);
+        ::CloseHandle(file);
+        if (mapping == NULL) {
+            return NULL;
+        }
+        void* view = ::MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        ::CloseHandle(mapping);
+        return view;
+    }
+
+    inline void unmapFile(void* ptr, size_t size) {
+        (void) size;
+        ::UnmapViewOfFile(ptr);
+    }
+
+    inline int getProcessId() {
+        return (int) ::GetCurrentProcessId();
+    }
 } // namespace platform
 
     // Constant expression helper
@@ -52,6 +153,9 @@ namespace platform {
 
 #else
     #include <unistd.h>
+    #include <fcntl.h>
+    #include <string>
+    #include <sys/mman.h>
     #include <sys/socket.h>
     #include <sys/ioctl.h>
     #include <netinet/in.h>
@@ -86,6 +190,108 @@ namespace platform {
     inline int bind(SOCKET s, const struct sockaddr* name, int namelen) {
         return ::bind(s, name, namelen);
     }
+
+    inline int openFileForWrite(const char* path) {
+        return ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    inline long long writeFile(int fd, const void* data, size_t length) {
+        return ::write(fd, data, length);
+    }
+
+    inline int syncFile(int fd) {
+    #ifdef __APPLE__
+        return ::fsync(fd);
+    #else
+        return ::fdatasync(fd);
+    #endif
+    }
+
+    inline int closeFile(int fd) {
+        return ::close(fd);
+    }
+
+    inline int preallocateFile(int fd, long long length) {
+    #ifdef __linux__
+        return ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, length);
+    #else
+        (void) fd;
+        (void) length;
+        return -1;
+    #endif
+    }
+
+    inline int truncateFile(int fd, long long length) {
+        return ::ftruncate(fd, length);
+    }
+
+    inline void* alignedAlloc(size_t alignment, size_t size) {
+        void* ptr = NULL;
+        if (::posix_memalign(&ptr, alignment, size) != 0) {
+            return NULL;
+        }
+        return ptr;
+    }
+
+    inline void alignedFree(void* ptr) {
+        ::free(ptr);
+    }
+
+    inline void* createSharedMemory(const char* name, size_t size) {
+        std::string path = std::string("/") + name;
+        int fd = ::shm_open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            return NULL;
+        }
+        if (::ftruncate(fd, (off_t) size) != 0) {
+            ::close(fd);
+            return NULL;
+        }
+        void* view = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        return (view == MAP_FAILED) ? NULL : view;
+    }
+
+    inline const void* openSharedMemory(const char* name, size_t size) {
+        std::string path = std::string("/") + name;
+        int fd = ::shm_open(path.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return NULL;
+        }
+        void* view = ::mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        return (view == MAP_FAILED) ? NULL : view;
+    }
+
+    inline void closeSharedMemory(const void* ptr, size_t size, const char* unlinkName) {
+        ::munmap(const_cast<void*>(ptr), size);
+        if (unlinkName != NULL) {
+            ::shm_unlink((std::string("/") + unlinkName).c_str());
+        }
+    }
+
+    inline void* mapFileForWrite(const char* path, size_t size) {
+        int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return NULL;
+        }
+        preallocateFile(fd, (long long) size);
+        if (::ftruncate(fd, (off_t) size) != 0) {
+            ::close(fd);
+            return NULL;
+        }
+        void* view = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        return (view == MAP_FAILED) ? NULL : view;
+    }
+
+    inline void unmapFile(void* ptr, size_t size) {
+        ::munmap(ptr, size);
+    }
+
+    inline int getProcessId() {
+        return (int) ::getpid();
+    }
 } // namespace platform
 
     #define CONSTEXPR constexpr
@@ -0,0 +1,259 @@
+#pragma once
+
+#ifndef _RECORDINGCODEC_H_
+#define _RECORDINGCODEC_H_
+
+/**
+ * @file recordingCodec.h
+ * @brief Lossless encodings for recording column blocks
+ *
+ * Both encodings work on the 64-bit patterns of a column, so they are exact for doubles and
+ * integers alike. The first value of a block is always stored in full, and each block decodes on
+ * its own.
+ *
+ * RECORDING_ENCODING_XOR XORs each value with the previous one and stores only the bits that
+ * changed, as in the Gorilla time-series format. A repeated value costs 1 bit. A changed value
+ * reuses the previous leading and trailing zero window when it fits (2 bits plus the window).
+ * Otherwise it costs 14 bits plus the changed bits. This suits slowly varying measurements, whose
+ * sign, exponent and high mantissa bits rarely change between samples.
+ *
+ * RECORDING_ENCODING_DELTA2 stores the difference between successive deltas as a zigzag varint. A
+ * counter or an evenly spaced clock costs one byte per value.
+ *
+ * Encoders return the number of bytes written, or 0 if the result would not fit in capacity. The
+ * writer uses that to fall back to a raw block. Decoders return false if the block is damaged.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+inline int recordingLeadingZeros(uint64_t x)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, x);
+  return 63 - (int) index;
+#else
+  return __builtin_clzll(x);
+#endif
+}
+
+inline int recordingTrailingZeros(uint64_t x)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, x);
+  return (int) index;
+#else
+  return __builtin_ctzll(x);
+#endif
+}
+
+/**
+ * Writes bits most significant first.
+ */
+struct RecordingBitWriter
+{
+  uint8_t* out;
+  size_t capacity;
+  size_t pos;
+  uint64_t acc;
+  int bits; // bits waiting in acc
+  bool overflow;
+
+  RecordingBitWriter(uint8_t* o, size_t c) : out(o), capacity(c), pos(0), acc(0), bits(0), overflow(false) {}
+
+  void write(uint64_t value, int n)
+  {
+    if (overflow) {
+      return;
+    }
+    if (n > 32) {
+      write(value >> 32, n - 32);
+      n = 32;
+    }
+    acc = (acc << n) | (value & ((1ULL << n) - 1));
+    bits += n;
+    while (bits >= 8) {
+      bits -= 8;
+      if (pos == capacity) {
+        overflow = true;
+        return;
+      }
+      out[pos++] = (uint8_t) (acc >> bits);
+    }
+  }
+
+  /**
+   * Pads the last byte with zeros and returns the number of bytes written, or 0 on overflow.
+   */
+  size_t finish()
+  {
+    if (!overflow && bits > 0) {
+      write(0, 8 - bits);
+    }
+    return overflow ? 0 : pos;
+  }
+};
+
+struct RecordingBitReader
+{
+  const uint8_t* in;
+  size_t length;
+  size_t pos;
+  uint64_t acc;
+  int bits;
+  bool overrun;
+
+  RecordingBitReader(const uint8_t* i, size_t l) : in(i), length(l), pos(0), acc(0), bits(0), overrun(false) {}
+
+  uint64_t read(int n)
+  {
+    if (n > 32) {
+      uint64_t high = read(n - 32);
+      return (high << 32) | read(32);
+    }
+    while (bits < n) {
+      uint8_t next = 0;
+      if (pos < length) {
+        next = in[pos++];
+      }
+      else {
+        overrun = true;
+      }
+      acc = (acc << 8) | next;
+      bits += 8;
+    }
+    bits -= n;
+    return (acc >> bits) & ((1ULL << n) - 1);
+  }
+};
+
+inline size_t recordingEncodeXor(const uint64_t* values, size_t count, uint8_t* out, size_t capacity)
+{
+  if (count == 0) {
+    return 0;
+  }
+  RecordingBitWriter writer(out, capacity);
+  uint64_t prev = values[0];
+  writer.write(prev, 64);
+  int prevLead = 64; // no window yet
+  int prevTrail = 0;
+  for (size_t i = 1; i < count && !writer.overflow; i++) {
+    uint64_t x = values[i] ^ prev;
+    prev = values[i];
+    if (x == 0) {
+      writer.write(0, 1);
+      continue;
+    }
+    int lead = recordingLeadingZeros(x);
+    int trail = recordingTrailingZeros(x);
+    if (lead >= prevLead && trail >= prevTrail) {
+      writer.write(2, 2);
+      writer.write(x >> prevTrail, 64 - prevLead - prevTrail);
+    }
+    else {
+      int significant = 64 - lead - trail;
+      writer.write(3, 2);
+      writer.write(lead, 6);
+      writer.write(significant - 1, 6);
+      writer.write(x >> trail, significant);
+      prevLead = lead;
+      prevTrail = trail;
+    }
+  }
+  return writer.finish();
+}
+
+inline bool recordingDecodeXor(const uint8_t* in, size_t length, uint64_t* values, size_t count)
+{
+  if (count == 0) {
+    return true;
+  }
+  RecordingBitReader reader(in, length);
+  uint64_t prev = reader.read(64);
+  values[0] = prev;
+  int prevLead = 64;
+  int prevTrail = 0;
+  for (size_t i = 1; i < count; i++) {
+    if (reader.read(1) == 0) {
+      values[i] = prev;
+      continue;
+    }
+    if (reader.read(1) == 0) {
+      if (prevLead == 64) {
+        return false;
+      }
+      prev ^= reader.read(64 - prevLead - prevTrail) << prevTrail;
+    }
+    else {
+      int lead = (int) reader.read(6);
+      int significant = (int) reader.read(6) + 1;
+      if (lead + significant > 64) {
+        return false;
+      }
+      prevLead = lead;
+      prevTrail = 64 - lead - significant;
+      prev ^= reader.read(significant) << prevTrail;
+    }
+    values[i] = prev;
+    if (reader.overrun) {
+      return false;
+    }
+  }
+  return !reader.overrun;
+}
+
+inline size_t recordingEncodeDelta2(const uint64_t* values, size_t count, uint8_t* out, size_t capacity)
+{
+  size_t pos = 0;
+  uint64_t prev = 0;
+  uint64_t prevDelta = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint64_t delta = values[i] - prev;
+    int64_t dod = (int64_t) (delta - prevDelta);
+    uint64_t zigzag = ((uint64_t) dod << 1) ^ (uint64_t) (dod >> 63);
+    prev = values[i];
+    prevDelta = delta;
+    do {
+      if (pos == capacity) {
+        return 0;
+      }
+      uint8_t byte = zigzag & 0x7f;
+      zigzag >>= 7;
+      out[pos++] = byte | (zigzag != 0 ? 0x80 : 0);
+    } while (zigzag != 0);
+  }
+  return pos;
+}
+
+inline bool recordingDecodeDelta2(const uint8_t* in, size_t length, uint64_t* values, size_t count)
+{
+  size_t pos = 0;
+  uint64_t prev = 0;
+  uint64_t prevDelta = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint64_t zigzag = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+      if (pos == length || shift > 63) {
+        return false;
+      }
+      byte = in[pos++];
+      zigzag |= (uint64_t) (byte & 0x7f) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    uint64_t dod = (zigzag >> 1) ^ (0 - (zigzag & 1));
+    prevDelta += dod;
+    prev += prevDelta;
+    values[i] = prev;
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,223 @@
+#pragma once
+
+#ifndef _RECORDINGFORMAT_H_
+#define _RECORDINGFORMAT_H_
+
+/**
+ * @file recordingFormat.h
+ * @brief On-disk layout of HapticEnvironment recordings
+ *
+ * A recording is a chunked columnar file:
+ *
+ *   RecordingFileHeader
+ *   RecordingColumnSchema[columnCount]
+ *   chunk 0, chunk 1, ...
+ *   RecordingChunkIndexEntry[chunkCount]
+ *   RecordingMarker[markerCount]
+ *   RecordingTrailer
+ *
+ * Each chunk is a RecordingChunkHeader, followed by one RecordingColumnBlock descriptor per column,
+ * followed by the column blocks themselves. Each block holds the values of one column for every
+ * row of the chunk, stored contiguously. Every structure and block starts on an 8-byte boundary,
+ * so a memory-mapped file can be read in place. All values are little-endian. A block may instead
+ * be compressed with one of the encodings in recordingCodec.h, chosen per block by the writer;
+ * its length is then the encoded size.
+ *
+ * The footer, made of the chunk index, the markers and the trailer, is written when the recording
+ * is closed. If the writer never got that far, the chunks can still be recovered by walking them
+ * from the end of the schema.
+ *
+ * A session may be split into segments, one file each. Segment 0 has the name given in
+ * START_RECORDING; the others are named by recordingSegmentPath. Each segment is a complete
+ * recording whose row numbers start at 0. The trial index file (recordingTrialIndexPath) has one
+ * fixed-size RecordingTrialEntry per trial, in trial order. It gives the segment and row at which
+ * each trial starts and ends, so a trial can be located without reading the segments.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#define RECORDING_MAGIC "HAPTREC1"
+#define RECORDING_TRAILER_MAGIC "HAPTEND1"
+#define RECORDING_TRIAL_INDEX_MAGIC "HAPTTRL1"
+#define RECORDING_CHUNK_MAGIC 0x4b4e4843 // "CHNK"
+#define RECORDING_VERSION 2 // version 2 added markers to the footer
+#define RECORDING_CHUNK_ROWS 4096 // rows per chunk, except the last one
+#define RECORDING_COLUMN_NAME_LENGTH 32
+
+#define RECORDING_TYPE_INT64 1
+#define RECORDING_TYPE_FLOAT64 2
+
+#define RECORDING_ENCODING_RAW 0
+#define RECORDING_ENCODING_XOR 1 // see recordingCodec.h
+#define RECORDING_ENCODING_DELTA2 2 // see recordingCodec.h
+
+#define RECORDING_MARKER_TRIAL_START 1
+#define RECORDING_MARKER_TRIAL_END 2
+#define RECORDING_MARKER_PAUSE 3 // no rows are recorded until the next RECORDING_MARKER_RESUME
+#define RECORDING_MARKER_RESUME 4
+
+#define RECORDING_TRIAL_COMPLETE 1 // the trial ended with TRIAL_END rather than the recording stopping
+
+typedef struct {
+  char magic[8]; // RECORDING_MAGIC
+  uint32_t version;
+  uint32_t columnCount;
+  uint32_t chunkRows; // maximum rows per chunk
+  uint32_t reserved;
+  double createdTime; // seconds since the Unix epoch
+} RecordingFileHeader;
+
+typedef struct {
+  char name[RECORDING_COLUMN_NAME_LENGTH];
+  uint32_t type; // RECORDING_TYPE_*
+  uint32_t elementSize; // bytes per value
+} RecordingColumnSchema;
+
+typedef struct {
+  uint32_t magic; // RECORDING_CHUNK_MAGIC
+  uint32_t rowCount;
+  uint64_t firstRow; // index of the first row of the chunk in the recording
+} RecordingChunkHeader;
+
+typedef struct {
+  uint32_t encoding; // RECORDING_ENCODING_*
+  uint32_t reserved;
+  uint64_t length; // bytes in the block, excluding padding to the next 8-byte boundary
+} RecordingColumnBlock;
+
+typedef struct {
+  uint64_t offset; // file offset of the RecordingChunkHeader
+  uint64_t firstRow;
+  uint32_t rowCount;
+  uint32_t reserved;
+} RecordingChunkIndexEntry;
+
+/**
+ * An event recorded between two rows. row is the number of rows of the segment that were recorded
+ * before the event, and time is on MessageHandler's clock.
+ */
+typedef struct {
+  uint32_t type; // RECORDING_MARKER_*
+  int32_t trialNum;
+  uint64_t row;
+  double time;
+} RecordingMarker;
+
+typedef struct {
+  uint64_t indexOffset; // file offset of the first RecordingChunkIndexEntry
+  uint64_t chunkCount;
+  uint64_t rowCount;
+  uint64_t markerOffset; // file offset of the first RecordingMarker
+  uint64_t markerCount;
+  char magic[8]; // RECORDING_TRAILER_MAGIC
+} RecordingTrailer;
+
+/**
+ * Trailer of version 1 files, which had no markers.
+ */
+typedef struct {
+  uint64_t indexOffset;
+  uint64_t chunkCount;
+  uint64_t rowCount;
+  char magic[8];
+} RecordingTrailerV1;
+
+typedef struct {
+  char magic[8]; // RECORDING_TRIAL_INDEX_MAGIC
+  uint32_t version;
+  uint32_t entrySize; // sizeof(RecordingTrialEntry)
+} RecordingTrialIndexHeader;
+
+/**
+ * One trial in the trial index. The trial covers rows [startRow, endRow) when it lies in a single
+ * segment. Otherwise it runs from startRow of startSegment to endRow of endSegment.
+ */
+typedef struct {
+  int32_t trialNum;
+  uint32_t flags; // RECORDING_TRIAL_*
+  uint32_t startSegment;
+  uint32_t endSegment;
+  uint64_t startRow;
+  uint64_t endRow;
+  double startTime;
+  double endTime;
+} RecordingTrialEntry;
+
+/**
+ * One recorded haptic sample, as produced by the streamer or the haptic tick tap. The writer
+ * stores each field as a column, in this order, named as in RECORDING_COLUMNS. Every field is
+ * 8 bytes, so the row can be transposed as an array of RECORDING_COLUMN_COUNT 64-bit values.
+ */
+typedef struct {
+  int64_t tick; // haptic tick index
+  double timestamp; // MessageHandler time the sample was taken or sent
+  double sampleTime; // MessageHandler time of the haptic tick
+  double posX;
+  double posY;
+  double posZ;
+  double velX;
+  double velY;
+  double velZ;
+  double forceX;
+  double forceY;
+  double forceZ;
+} RecordingRow;
+
+#define RECORDING_COLUMN_COUNT 12
+
+static const RecordingColumnSchema RECORDING_COLUMNS[RECORDING_COLUMN_COUNT] = {
+  {"tick", RECORDING_TYPE_INT64, 8},
+  {"timestamp", RECORDING_TYPE_FLOAT64, 8},
+  {"sampleTime", RECORDING_TYPE_FLOAT64, 8},
+  {"posX", RECORDING_TYPE_FLOAT64, 8},
+  {"posY", RECORDING_TYPE_FLOAT64, 8},
+  {"posZ", RECORDING_TYPE_FLOAT64, 8},
+  {"velX", RECORDING_TYPE_FLOAT64, 8},
+  {"velY", RECORDING_TYPE_FLOAT64, 8},
+  {"velZ", RECORDING_TYPE_FLOAT64, 8},
+  {"forceX", RECORDING_TYPE_FLOAT64, 8},
+  {"forceY", RECORDING_TYPE_FLOAT64, 8},
+  {"forceZ", RECORDING_TYPE_FLOAT64, 8}
+};
+
+/**
+ * @param base File name given in START_RECORDING
+ * @param segment Segment number
+ *
+ * Returns the path of a segment. Segment 0 is base itself. Later segments insert a four-digit
+ * segment number before the extension, so "session.rec" continues as "session_0001.rec".
+ */
+inline std::string recordingSegmentPath(const std::string& base, uint32_t segment)
+{
+  if (segment == 0) {
+    return base;
+  }
+  size_t slash = base.find_last_of("/\\");
+  size_t dot = base.find_last_of('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    dot = base.size();
+  }
+  char suffix[16];
+  snprintf(suffix, sizeof(suffix), "_%04u", segment);
+  return base.substr(0, dot) + suffix + base.substr(dot);
+}
+
+/**
+ * Returns the path of the trial index that belongs to the recording started as base.
+ */
+inline std::string recordingTrialIndexPath(const std::string& base)
+{
+  return base + ".trials";
+}
+
+/**
+ * Rounds a byte count up to the next 8-byte boundary.
+ */
+inline uint64_t recordingPad(uint64_t length)
+{
+  return (length + 7) & ~((uint64_t) 7);
+}
+
+#endif
@@ -0,0 +1,161 @@
+#pragma once
+
+#ifndef _STATSPAGE_H_
+#define _STATSPAGE_H_
+
+/**
+ * @file statsPage.h
+ * @brief Layout of the runtime statistics page that HapticEnvironment shares with local dashboards
+ *
+ * HapticEnvironment creates a shared memory object named STATS_PAGE_NAME and rewrites it every
+ * STATS_PAGE_INTERVAL seconds. Other processes map it read-only and copy it out with readStatsPage.
+ * The writer bumps sequence to an odd value before it changes data and to the next even value
+ * afterwards, so a reader can tell when its copy was torn and try again. The writer never waits
+ * for readers.
+ *
+ * Durations are in seconds. Percentiles come from log-linear histograms and are accurate to about
+ * 3 percent of the value. Counters count from the start of the program, or from the last
+ * resetStats for the histograms.
+ */
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+#define STATS_PAGE_NAME "HapticEnvironmentStats"
+#define STATS_PAGE_MAGIC 0x53544154 // "STAT"
+#define STATS_PAGE_VERSION 5
+#define STATS_PAGE_INTERVAL 0.1 // seconds between updates of the page
+#define STATS_MSG_TYPES 64 // message types tracked separately, in order of first arrival
+#define STATS_PERF_PHASES 5 // phases of the haptic tick, in the order of PERF_PHASE_* in perfCounters.h
+#define STATS_PERF_COUNTERS 4 // cycles, instructions, LLC misses, context switches (PERF_COUNTER_*)
+#define STATS_PERF_WINDOW 1.0 // seconds over which performance counter rates are taken
+
+/**
+ * Summary of one histogram.
+ */
+struct StatsSummary
+{
+  uint64_t count;
+  double mean;
+  double p50;
+  double p90;
+  double p99;
+  double p999;
+  double max;
+};
+
+/**
+ * Statistics of one message type. Latencies run from the header timestamp, on MessageHandler's
+ * clock, to the local time converted to that clock: when the listener read the packet, when
+ * parsePacket finished with it, and the first haptic tick and the first frame that started after
+ * it was parsed. They are cleared at SESSION_START.
+ */
+struct StatsMessageSummary
+{
+  int32_t msgType;
+  int32_t reserved;
+  uint64_t received;
+  StatsSummary parseTime; // time spent in parsePacket
+  StatsSummary receiveLatency;
+  StatsSummary parseLatency;
+  StatsSummary tickLatency;
+  StatsSummary frameLatency;
+};
+
+/**
+ * Performance counters of one phase of the haptic tick. Rates and per tick averages are taken over
+ * the last STATS_PERF_WINDOW.
+ */
+struct StatsPerfPhase
+{
+  uint64_t totals[STATS_PERF_COUNTERS];
+  double perSecond[STATS_PERF_COUNTERS];
+  double perTick[STATS_PERF_COUNTERS];
+};
+
+struct StatsPageData
+{
+  double time; // MessageHandler clock at the update
+  double uptime; // seconds since the program started
+
+  // Loops
+  double hapticRate; // ticks per second
+  double graphicsRate; // frames per second
+  StatsSummary hapticPeriod; // time between successive haptic ticks
+  StatsSummary hapticJitter; // change in the haptic period from one tick to the next
+  StatsSummary framePeriod; // time between successive frames
+  StatsSummary swapLatency; // from the device read of the haptic tick a frame rendered to the end of its buffer swap
+  StatsSummary predictionError; // distance from a predicted cursor position to the true one, in world units, not seconds
+  double predictionHorizon; // latest horizon of the cursor prediction, 0 if prediction is off
+
+  // Messaging
+  uint64_t packetsIn;
+  uint64_t packetsLost; // gaps in sequence numbers
+  uint64_t kernelDrops;
+  double packetsInRate;
+  uint64_t packetsOut;
+  uint64_t packetsOutDropped;
+  uint64_t packetsOutFailed;
+  double packetsOutRate;
+  uint64_t publisherQueueDepth;
+  uint64_t streamSamples;
+  uint64_t streamMissedDeadlines;
+
+  // Recording
+  uint64_t recordingBytes;
+  uint64_t recordingRows;
+  uint64_t recordingRowsDropped;
+  uint64_t recorderQueueDepth;
+  uint64_t recorderHighWaterMark;
+  double recordingBytesRate;
+  double recordingRowsRate;
+
+  uint64_t logRecordsDropped;
+
+  // Haptic thread performance counters, with --perf-counters on Linux
+  uint32_t perfAvailable; // bit (1 << counter) for each counter that could be opened, 0 if off
+  uint32_t perfReserved;
+  double perfTickRate; // ticks counted per second
+  StatsPerfPhase perfPhases[STATS_PERF_PHASES];
+
+  uint32_t msgTypeCount; // entries used in messages
+  uint32_t reserved;
+  StatsMessageSummary messages[STATS_MSG_TYPES];
+};
+
+struct StatsPage
+{
+  uint32_t magic;
+  uint32_t version;
+  std::atomic<uint64_t> sequence; // odd while data is being rewritten
+  StatsPageData data;
+};
+
+/**
+ * @param page The mapped statistics page
+ * @param data Filled with a consistent copy of the page
+ *
+ * Returns false if the page is not a statistics page of this version, or if the writer kept
+ * changing it while it was being copied.
+ */
+inline bool readStatsPage(const StatsPage* page, StatsPageData* data)
+{
+  if (page->magic != STATS_PAGE_MAGIC || page->version != STATS_PAGE_VERSION) {
+    return false;
+  }
+  for (int attempt = 0; attempt < 100; attempt++) {
+    uint64_t before = page->sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+      continue;
+    }
+    memcpy(data, &page->data, sizeof(*data));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (page->sequence.load(std::memory_order_relaxed) == before) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif
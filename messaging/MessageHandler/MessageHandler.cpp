@@ -23,6 +23,9 @@ MessageHandler::~MessageHandler()
 #ifdef _WIN32
   WSACleanup();
 #endif
+  for (map<int, SubscriberQueue*>::iterator it = moduleQueues.begin(); it != moduleQueues.end(); ++it) {
+    delete it->second;
+  }
   delete srv;
 }
 
@@ -31,6 +34,23 @@ rpc::server* MessageHandler::getServer()
   return srv;  
 }
 
+/**
+ * Binds every MessageHandler RPC method on the server. Used by the standalone messageHandler and by
+ * HapticEnvironment when it hosts the broker in-process, so both expose the same interface.
+ */
+void MessageHandler::bindMethods()
+{
+  srv->bind("getMsgNum", [this](){return getMsgNum();});
+  srv->bind("getTimestamp", [this](){return getTimestamp();});
+  srv->bind("addModule", [this](int moduleID, string ipAddr, int port){return addModule(moduleID, ipAddr, port);});
+  srv->bind("subscribeTo", [this](int myID, int subscribeID){return subscribeTo(myID, subscribeID);});
+  srv->bind("subscribeToTypes", [this](int myID, int subscribeID, vector<int> msgTypes){return subscribeToTypes(myID, subscribeID, msgTypes);});
+  srv->bind("setMaxRate", [this](int myID, int subscribeID, int msgType, double maxRate){return setMaxRate(myID, subscribeID, msgType, maxRate);});
+  srv->bind("sendMessage", [this](vector<char> packet, uint16_t lengthPacket, int sendingModule){return sendMessage(packet, lengthPacket, sendingModule);});
+  srv->bind("getQueueStats", [this](int moduleID){return getQueueStats(moduleID);});
+  srv->bind("testMessage", [this](int val){return testMessage(val);});
+}
+
 int MessageHandler::getMsgNum()
 {
   return msgNum++;
@@ -94,15 +114,22 @@ int MessageHandler::addModule(int moduleID, string ipAddr, int port) //, const i
     return 0;
   }*/
 
+  lock_guard<recursive_mutex> guard(routeLock);
   moduleSubscribers[moduleID] = {};
   moduleSockets[moduleID] = sock;
   socketStructs[sock] = sockStruct;
+  map<int, SubscriberQueue*>::iterator queueIt = moduleQueues.find(moduleID);
+  if (queueIt != moduleQueues.end()) {
+    delete queueIt->second;
+  }
+  moduleQueues[moduleID] = new SubscriberQueue(moduleID, sock, sockStruct, DEFAULT_DATA_LANE_CAPACITY);
   cout << "Added module " << moduleID << ":\t" << inet_ntoa(sockStruct.sin_addr) << ":" << ntohs(sockStruct.sin_port) << endl;
   return 1;
 }
 
 int MessageHandler::subscribeTo(int myID, int subscribeID) 
 {
+  lock_guard<recursive_mutex> guard(routeLock);
   map<int, set<int>>::iterator it = moduleSubscribers.find(subscribeID);
   if (it == moduleSubscribers.end() && subscribeID != 999) {
     cout << "Could not find module ID " << subscribeID << "." << endl;
@@ -111,40 +138,124 @@ int MessageHandler::subscribeTo(int myID, int subscribeID)
   if (subscribeID == 999) {
     for (map<int, set<int>>::iterator modIt = moduleSubscribers.begin(); modIt != moduleSubscribers.end(); ++modIt) {
       moduleSubscribers[modIt->first].insert(myID);
+      subscriberFilters[modIt->first].erase(myID);
     }
     return 1;
   }
   moduleSubscribers[subscribeID].insert(myID);
+  subscriberFilters[subscribeID].erase(myID);
   return 1;
 }
 
-int MessageHandler::sendMessage(vector<char> packet, uint16_t lengthPacket, int sendingModule)
+/**
+ * Subscribes myID to subscribeID, but only forwards the message types listed in msgTypes. Calling
+ * subscribeTo afterwards removes the filter again. A subscribeID of 999 applies the filter to every
+ * module that has been added.
+ */
+int MessageHandler::subscribeToTypes(int myID, int subscribeID, vector<int> msgTypes)
+{
+  lock_guard<recursive_mutex> guard(routeLock);
+  if (subscribeTo(myID, subscribeID) == 0) {
+    return 0;
+  }
+  set<int> allowed(msgTypes.begin(), msgTypes.end());
+  if (subscribeID == 999) {
+    for (map<int, set<int>>::iterator modIt = moduleSubscribers.begin(); modIt != moduleSubscribers.end(); ++modIt) {
+      subscriberFilters[modIt->first][myID].msgTypes = allowed;
+    }
+    return 1;
+  }
+  subscriberFilters[subscribeID][myID].msgTypes = allowed;
+  return 1;
+}
+
+/**
+ * Limits how often messages of msgType are forwarded from subscribeID to myID. Messages arriving
+ * faster than maxRate (in Hz) are dropped by the broker before they are sent. A maxRate of zero or
+ * less removes the limit. myID must already be subscribed to subscribeID.
+ */
+int MessageHandler::setMaxRate(int myID, int subscribeID, int msgType, double maxRate)
+{
+  lock_guard<recursive_mutex> guard(routeLock);
+  map<int, set<int>>::iterator it = moduleSubscribers.find(subscribeID);
+  if (it == moduleSubscribers.end() || it->second.count(myID) == 0) {
+    cout << "Module " << myID << " is not subscribed to module " << subscribeID << "." << endl;
+    return 0;
+  }
+  SubscriberFilter& filter = subscriberFilters[subscribeID][myID];
+  if (maxRate <= 0) {
+    filter.minInterval.erase(msgType);
+    filter.lastSent.erase(msgType);
+  }
+  else {
+    filter.minInterval[msgType] = 1.0/maxRate;
+  }
+  return 1;
+}
+
+/**
+ * Checks the type filter and rate limit of receivingModule's subscription to sendingModule, and
+ * records the send time when the message is let through. Called with routeLock held.
+ */
+bool MessageHandler::passesFilter(int sendingModule, int receivingModule, int msgType)
+{
+  map<int, map<int, SubscriberFilter>>::iterator modIt = subscriberFilters.find(sendingModule);
+  if (modIt == subscriberFilters.end()) {
+    return true;
+  }
+  map<int, SubscriberFilter>::iterator filterIt = modIt->second.find(receivingModule);
+  if (filterIt == modIt->second.end()) {
+    return true;
+  }
+  SubscriberFilter& filter = filterIt->second;
+  if (!filter.msgTypes.empty() && filter.msgTypes.count(msgType) == 0) {
+    return false;
+  }
+  map<int, double>::iterator rateIt = filter.minInterval.find(msgType);
+  if (rateIt != filter.minInterval.end()) {
+    double now = getTimestamp();
+    map<int, double>::iterator lastIt = filter.lastSent.find(msgType);
+    if (lastIt != filter.lastSent.end() && now - lastIt->second < rateIt->second) {
+      return false;
+    }
+    filter.lastSent[msgType] = now;
+  }
+  return true;
+}
+
+/**
+ * Routes a packet from sendingModule to every module subscribed to it, after applying each
+ * subscriber's filter. Before queueing, the header is stamped with the sending module and a
+ * sequence number that counts messages of this msg_type on this route, so receivers can detect
+ * lost, duplicated and reordered packets. The packet is modified in place.
+ */
+int MessageHandler::routeMessage(char* packet, uint16_t lengthPacket, int sendingModule)
 { 
-  /*MSG_HEADER header;
-  memcpy(&header, reinterpret_cast<char*> (&packet[0]), sizeof(header));
-  if (header.msg_type == CST_CREATE) {
-    cout << "RECEIVED CST_CREATE MESSAGE" << endl;
-  }*/
+  MSG_HEADER header;
+  memset(&header, 0, sizeof(header));
+  bool hasHeader = lengthPacket >= sizeof(header);
+  if (hasHeader) {
+    memcpy(&header, packet, sizeof(header));
+  }
+  lock_guard<recursive_mutex> guard(routeLock);
   map<int, set<int>>::iterator it = moduleSubscribers.find(sendingModule);
-  set<int> receivingModules;
   if (it != moduleSubscribers.end()) {
-    receivingModules = moduleSubscribers[sendingModule];
-    for (set<int>::iterator setIt = receivingModules.begin(); setIt != receivingModules.end(); ++setIt) {
-      int socketNum = moduleSockets[*setIt];
-      struct sockaddr_in sockStruct = socketStructs[socketNum];
-      int socketLen = sizeof(sockStruct);
-      
-#ifdef _WIN32
-      if (sendto(socketNum, (const char*)&packet[0], lengthPacket, 0, (struct sockaddr*) &(socketStructs[socketNum]), socketLen) == SOCKET_ERROR) {
-        cout << "Data sending error for module " << sendingModule << " sending to module " << *setIt << " with error: " << WSAGetLastError() << endl;
-        return 0;
+    const set<int>& receivingModules = it->second;
+    for (set<int>::const_iterator setIt = receivingModules.begin(); setIt != receivingModules.end(); ++setIt) {
+      if (!passesFilter(sendingModule, *setIt, header.msg_type)) {
+        continue;
       }
-#else
-      if (sendto(socketNum, &packet[0], lengthPacket, 0, (struct sockaddr*) &(socketStructs[socketNum]), socketLen) < 0) {
-        cout << "Data sending error for module " << sendingModule << " sending to module " << *setIt << "." << endl;
-        return 0;
+      map<int, SubscriberQueue*>::iterator queueIt = moduleQueues.find(*setIt);
+      if (queueIt == moduleQueues.end()) {
+        continue;
       }
-#endif
+      if (hasHeader) {
+        header.source_module = sendingModule;
+        // The counter wraps; SequenceTracker sees the jump back to INT_MIN as a sender reset.
+        header.source_seq = (int) routeSequences[sendingModule][*setIt][header.msg_type]++;
+        memcpy(packet, &header, sizeof(header));
+      }
+      queueIt->second->push(packet, lengthPacket, !isDataMessage(header.msg_type));
     }
     return 1; 
   }
@@ -154,74 +265,60 @@ int MessageHandler::sendMessage(vector<char> packet, uint16_t lengthPacket, int
   
 }
 
-int MessageHandler::testMessage(int val)
+/**
+ * RPC entry point for sending a message. lengthPacket is clamped to the size of the packet data.
+ */
+int MessageHandler::sendMessage(vector<char> packet, uint16_t lengthPacket, int sendingModule)
 {
-  cout << "Test message received with value " << val << endl;
-  return 1;
+  if (packet.empty()) {
+    return routeMessage(NULL, 0, sendingModule);
+  }
+  if (lengthPacket > packet.size()) {
+    lengthPacket = (uint16_t) packet.size();
+  }
+  return routeMessage(&packet[0], lengthPacket, sendingModule);
 }
 
-int main(int argc, char *argv[])
+/**
+ * Direct entry point for an in-process sender. The packet is copied, so the caller keeps ownership
+ * of its buffer.
+ */
+int MessageHandler::sendMessage(const char* packet, uint16_t lengthPacket, int sendingModule)
 {
-  cout << "Starting MessageHandler initialization..." << endl;
-  
-  //TODO: Read Ports and IP address from config file
-  const char* IP;
-  int PORT;
-  
-  try {
-    cout << "Parsing command line arguments..." << endl;
-    if (argc <= 2) {
-      IP = "127.0.0.1";
-      PORT = 8080;
-      cout << "Using default IP and PORT: " << IP << ":" << PORT << endl;
-    } else {
-      IP = argv[1];
-      PORT = atoi(argv[2]);
-      cout << "Using provided IP and PORT: " << IP << ":" << PORT << endl;
-    }
-
-    cout << "Creating MessageHandler instance..." << endl;
-    MessageHandler* mh = new MessageHandler(IP, PORT);
-    if (!mh) {
-      cout << "Failed to create MessageHandler instance!" << endl;
-      return 1;
-    }
-    cout << "Successfully created MessageHandler with IP " << IP << " and PORT " << PORT << endl;
-
-    cout << "Binding RPC methods..." << endl;
-    try {
-      mh->getServer()->bind("getMsgNum", [&mh](){return mh->getMsgNum();});
-      mh->getServer()->bind("getTimestamp", [&mh](){return mh->getTimestamp();});
-      mh->getServer()->bind("addModule", [&mh](int moduleID, string ipAddr, int port){return mh->addModule(moduleID, ipAddr, port);});
-      mh->getServer()->bind("subscribeTo", [&mh](int myID, int subscribeID){return mh->subscribeTo(myID, subscribeID);});
-      mh->getServer()->bind("sendMessage", [&mh](vector<char> packet, uint16_t lengthPacket, int sendingModule){return mh->sendMessage(packet, lengthPacket, sendingModule);});
-      mh->getServer()->bind("testMessage", [&mh](int val){return mh->testMessage(val);});
-      cout << "Successfully bound all RPC methods" << endl;
-    } catch (const exception& e) {
-      cout << "Failed to bind RPC methods: " << e.what() << endl;
-      delete mh;
-      return 1;
-    }
-
-    cout << "Starting RPC server..." << endl;
-    try {
-      mh->getServer()->run();
-    } catch (const exception& e) {
-      cout << "Server failed to run: " << e.what() << endl;
-      delete mh;
-      return 1;
-    }
-    
-    cout << "Cleaning up..." << endl;
-    delete mh;
-    cout << "MessageHandler shutdown complete" << endl;
-    return 0;
+  char copy[MAX_PACKET_LENGTH];
+  if (lengthPacket > MAX_PACKET_LENGTH) {
+    lengthPacket = MAX_PACKET_LENGTH;
+  }
+  memcpy(copy, packet, lengthPacket);
+  return routeMessage(copy, lengthPacket, sendingModule);
+}
 
-  } catch (const exception& e) {
-    cout << "Fatal error: " << e.what() << endl;
-    return 1;
-  } catch (...) {
-    cout << "Unknown fatal error occurred" << endl;
-    return 1;
+/**
+ * Returns the send queue counters for one receiving module: packets sent, dropped and failed, and
+ * the current queue depth, separately for the control and data lanes.
+ */
+map<string, uint64_t> MessageHandler::getQueueStats(int moduleID)
+{
+  map<string, uint64_t> stats;
+  lock_guard<recursive_mutex> guard(routeLock);
+  map<int, SubscriberQueue*>::iterator it = moduleQueues.find(moduleID);
+  if (it == moduleQueues.end()) {
+    return stats;
   }
+  SubscriberQueue* queue = it->second;
+  stats["controlSent"] = queue->getSent(true);
+  stats["controlDropped"] = queue->getDropped(true);
+  stats["controlFailed"] = queue->getFailed(true);
+  stats["controlDepth"] = queue->getDepth(true);
+  stats["dataSent"] = queue->getSent(false);
+  stats["dataDropped"] = queue->getDropped(false);
+  stats["dataFailed"] = queue->getFailed(false);
+  stats["dataDepth"] = queue->getDepth(false);
+  return stats;
+}
+
+int MessageHandler::testMessage(int val)
+{
+  cout << "Test message received with value " << val << endl;
+  return 1;
 }
@@ -10,6 +10,7 @@
 #include "rpc/server.h"
 #include <string>
 #include <map>
+#include <mutex>
 #include <set>
 
 #ifdef _WIN32
@@ -25,10 +26,41 @@
 #endif
 
 #include "messageDefinitions.h"
+#include "SubscriberQueue.h"
 
 using namespace std::chrono;
 using namespace std;
 
+/**
+ * Returns true for message types that carry high-rate telemetry. These go through the data lane of
+ * a SubscriberQueue, where old packets are dropped when a subscriber falls behind. Every other
+ * message type is a control message and is never dropped.
+ */
+inline bool isDataMessage(int msgType)
+{
+  return (msgType == HAPTIC_DATA_STREAM || msgType == CST_DATA || msgType == CUPS_DATA);
+}
+
+/**
+ * SubscriberFilter narrows what a subscriber receives from one sending module. An empty msgTypes
+ * set forwards every message type. minInterval holds, per message type, the minimum number of
+ * seconds between two forwarded messages, which decimates high-rate streams for slow consumers.
+ */
+struct SubscriberFilter
+{
+  set<int> msgTypes; // allowed message types, empty means all types
+  map<int, double> minInterval; // msg_type to minimum seconds between forwarded messages
+  map<int, double> lastSent; // msg_type to timestamp of the last forwarded message
+};
+
+/**
+ * MessageHandler routes packets between modules. It normally runs as its own process (main.cpp),
+ * but it is also built as a library so that HapticEnvironment can host it in-process with
+ * --embed-broker. In that mode the RPC server still listens on the usual port for the other
+ * modules, while HapticEnvironment calls getMsgNum, getTimestamp and sendMessage directly. The
+ * routing tables are guarded by routeLock because RPC handlers and direct callers run on different
+ * threads.
+ */
 class MessageHandler 
 {
   private:
@@ -39,6 +71,12 @@ class MessageHandler
     map<int, set<int>> moduleSubscribers; // map of moduleID to IDs of modules that subscribe to that module
     map<int, int> moduleSockets; // map of moduleID to socket number 
     map<int, struct sockaddr_in> socketStructs; //map of socket number to the socket struct
+    map<int, SubscriberQueue*> moduleQueues; // map of moduleID to its outgoing send queue
+    map<int, map<int, SubscriberFilter>> subscriberFilters; // map of moduleID to (subscriber ID to filter)
+    map<int, map<int, map<int, uint32_t>>> routeSequences; // map of moduleID to (subscriber ID to (msg_type to next sequence number)); unsigned so it wraps
+    recursive_mutex routeLock; // guards the subscriber, socket, queue, filter and sequence maps
+    bool passesFilter(int sendingModule, int receivingModule, int msgType);
+    int routeMessage(char* packet, uint16_t lengthPacket, int sendingModule);
 
 #ifdef _WIN32
     WSADATA wsaData;
@@ -48,11 +86,16 @@ class MessageHandler
     MessageHandler(const char* address, int iPort);
     ~MessageHandler();
     rpc::server* getServer();
+    void bindMethods();
     int getMsgNum();
     double getTimestamp();
     int addModule(int moduleID, string ipAddr, int port); //, const int subscriberList[10]);
     int subscribeTo(int myID, int subscribeID);
+    int subscribeToTypes(int myID, int subscribeID, vector<int> msgTypes);
+    int setMaxRate(int myID, int subscribeID, int msgType, double maxRate);
     int sendMessage(vector<char> packet, uint16_t lengthPacket, int module);
+    int sendMessage(const char* packet, uint16_t lengthPacket, int module);
+    map<string, uint64_t> getQueueStats(int moduleID);
     int testMessage(int val);
 };
 
@@ -0,0 +1,110 @@
+#include "SubscriberQueue.h"
+#include <iostream>
+
+/**
+ * @param module ID of the receiving module
+ * @param socketNum Socket used to send to the receiving module
+ * @param address Address of the receiving module
+ * @param dataCapacity Maximum number of queued data packets before the oldest is dropped
+ *
+ * Starts one sender thread for the control lane and one for the data lane.
+ */
+SubscriberQueue::SubscriberQueue(int module, int socketNum, struct sockaddr_in address, size_t dataCapacity)
+{
+  moduleID = module;
+  sock = socketNum;
+  sockStruct = address;
+  controlLane.capacity = 0;
+  dataLane.capacity = dataCapacity;
+  controlLane.sender = thread(&SubscriberQueue::runSender, this, &controlLane);
+  dataLane.sender = thread(&SubscriberQueue::runSender, this, &dataLane);
+}
+
+SubscriberQueue::~SubscriberQueue()
+{
+  running = false;
+  Lane* lanes[2] = {&controlLane, &dataLane};
+  for (int i = 0; i < 2; i++) {
+    {
+      lock_guard<mutex> guard(lanes[i]->lock);
+    }
+    lanes[i]->ready.notify_all();
+    if (lanes[i]->sender.joinable()) {
+      lanes[i]->sender.join();
+    }
+  }
+}
+
+/**
+ * Queues a copy of the packet on the control or data lane. When the data lane is full, the oldest
+ * queued data packet is dropped to make room. The control lane is unbounded.
+ */
+void SubscriberQueue::push(const char* packet, uint16_t lengthPacket, bool control)
+{
+  Lane& lane = control ? controlLane : dataLane;
+  {
+    lock_guard<mutex> guard(lane.lock);
+    if (lane.capacity > 0 && lane.packets.size() >= lane.capacity) {
+      lane.packets.pop_front();
+      lane.dropped++;
+    }
+    lane.packets.emplace_back(packet, packet + lengthPacket);
+  }
+  lane.ready.notify_one();
+}
+
+/**
+ * Sender thread body. Waits for packets on one lane and sends them to the receiving module.
+ */
+void SubscriberQueue::runSender(Lane* lane)
+{
+  vector<char> packet;
+  while (true) {
+    {
+      unique_lock<mutex> guard(lane->lock);
+      lane->ready.wait(guard, [&]{ return !lane->packets.empty() || !running; });
+      if (lane->packets.empty()) {
+        return;
+      }
+      packet.swap(lane->packets.front());
+      lane->packets.pop_front();
+    }
+    int socketLen = sizeof(sockStruct);
+#ifdef _WIN32
+    if (sendto(sock, (const char*)&packet[0], (int)packet.size(), 0, (struct sockaddr*) &sockStruct, socketLen) == SOCKET_ERROR) {
+      cout << "Data sending error to module " << moduleID << " with error: " << WSAGetLastError() << endl;
+      lane->failed++;
+      continue;
+    }
+#else
+    if (sendto(sock, &packet[0], packet.size(), 0, (struct sockaddr*) &sockStruct, socketLen) < 0) {
+      cout << "Data sending error to module " << moduleID << "." << endl;
+      lane->failed++;
+      continue;
+    }
+#endif
+    lane->sent++;
+  }
+}
+
+uint64_t SubscriberQueue::getSent(bool control)
+{
+  return control ? controlLane.sent.load() : dataLane.sent.load();
+}
+
+uint64_t SubscriberQueue::getDropped(bool control)
+{
+  return control ? controlLane.dropped.load() : dataLane.dropped.load();
+}
+
+uint64_t SubscriberQueue::getFailed(bool control)
+{
+  return control ? controlLane.failed.load() : dataLane.failed.load();
+}
+
+size_t SubscriberQueue::getDepth(bool control)
+{
+  Lane& lane = control ? controlLane : dataLane;
+  lock_guard<mutex> guard(lane.lock);
+  return lane.packets.size();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#ifndef _SUBSCRIBERQUEUE_H_
+#define _SUBSCRIBERQUEUE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/socket.h>
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+#endif
+
+using namespace std;
+
+#define DEFAULT_DATA_LANE_CAPACITY 256 // packets queued per subscriber before the oldest is dropped
+
+/**
+ * SubscriberQueue owns the outgoing traffic for one receiving module. Packets are split into a
+ * control lane and a data lane, each drained by its own sender thread, so a burst of telemetry
+ * never sits in front of a trial control command and a slow receiver never blocks the publisher.
+ */
+class SubscriberQueue
+{
+  private:
+    struct Lane
+    {
+      deque<vector<char>> packets;
+      size_t capacity; // 0 means unbounded
+      mutex lock;
+      condition_variable ready;
+      thread sender;
+      atomic<uint64_t> sent{0};
+      atomic<uint64_t> dropped{0};
+      atomic<uint64_t> failed{0};
+    };
+
+    int moduleID;
+    int sock;
+    struct sockaddr_in sockStruct;
+    atomic_bool running{true};
+    Lane controlLane;
+    Lane dataLane;
+    void runSender(Lane* lane);
+
+  public:
+    SubscriberQueue(int module, int socketNum, struct sockaddr_in address, size_t dataCapacity);
+    ~SubscriberQueue();
+    void push(const char* packet, uint16_t lengthPacket, bool control);
+    uint64_t getSent(bool control);
+    uint64_t getDropped(bool control);
+    uint64_t getFailed(bool control);
+    size_t getDepth(bool control);
+};
+
+#endif
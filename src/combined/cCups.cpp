@@ -140,22 +140,11 @@ void cCups::updateNextBallPosition(double dt)
   
   M_CUPS_DATA cupsData;
   memset(&cupsData, 0, sizeof(cupsData));
-  auto packetIdx = controlData.client->async_call("getMsgNum");
-  auto timestamp = controlData.client->async_call("getTimestamp");
-  packetIdx.wait();
-  timestamp.wait();
-  int packetNum = packetIdx.get().as<int>();
-  double currTime = timestamp.get().as<double>();
-  cupsData.header.serial_no = packetNum;
   cupsData.header.msg_type = CUPS_DATA;
-  cupsData.header.timestamp = currTime;
+  cupsData.header.timestamp = getMessageHandlerTime();
   cupsData.ballPos = ballPos;
   cupsData.cartPos = cartPos;
-  char packet[sizeof(cupsData)];
-  memcpy(&packet, &cupsData, sizeof(cupsData));
-    vector<char> packetData(packet, packet+sizeof(packet) / sizeof(char));
-
-  auto cupsInt = controlData.client->async_call("sendMessage", packetData, sizeof(cupsData), controlData.MODULE_NUM);    
+  publishMessage(&cupsData, sizeof(cupsData));
 
 }
 
@@ -1,9 +1,15 @@
 #include "controller.h"
 #include "platform_compat.h"
+#include "MessageHandler.h"
 #include "debug.h"
+#include "flightRecorder.h"
+#include "stats.h"
+#include "timing.h"
+#include "trace.h"
 #include <csignal>
 #include <sstream>
 #include <iomanip>
+#include <mutex>
 #include <windows.h>
 #include <dbghelp.h>
 
@@ -24,9 +30,11 @@ ControlData controlData;
 
 // Signal handler
 void signal_handler(int sig) {
-    std::stringstream ss;
-    ss << "Received signal " << sig;
-    debug_log(__FILE__, __LINE__, __FUNCTION__, ss.str().c_str());
+    flightRecorderCrash(sig);
+    flushLoggerFromSignal();
+    char message[64];
+    int length = snprintf(message, sizeof(message), "Received signal %d\n", sig);
+    fwrite(message, 1, (size_t) length, stderr);
     print_stack_trace();
     exit(1);
 }
@@ -42,6 +50,7 @@ void setup_signal_handlers() {
 int main(int argc, char* argv[])
 {
   setup_signal_handlers();
+  startLogger();
   debug_log(__FILE__, __LINE__, __FUNCTION__, "Starting application");
 
   const char* MODULE_IP;
@@ -57,7 +66,124 @@ int main(int argc, char* argv[])
   controlData.hapticsUp = false;
   controlData.listenerUp = false;
   controlData.streamerUp = false;
-  controlData.loggingData = false;
+  controlData.publisherUp = false;
+  controlData.recorderUp = false;
+  controlData.streamRate = STREAM_RATE_DEFAULT;
+  controlData.rcvbufAuto = false;
+  controlData.recordTicks = false;
+  controlData.perfCounters = false;
+  graphicsData.framePacing = GRAPHICS_PACING_VSYNC;
+  graphicsData.frameRateCap = GRAPHICS_FRAME_RATE_DEFAULT;
+  graphicsData.finishAfterSwap = false;
+  graphicsData.prediction = GRAPHICS_PREDICT_OFF;
+  graphicsData.predictionHorizon = 0.0;
+  graphicsData.predictionFilter = GRAPHICS_PREDICT_FILTER_DEFAULT;
+  bool embedBroker = false;
+  bool segmentPerTrial = false;
+  uint64_t segmentBytes = 0;
+  int statsPort = STATS_RPC_PORT_DEFAULT;
+  string flightFile = FLIGHT_DEFAULT_FILE;
+
+  // Options start with "--" and may appear anywhere. They are removed from argv so the positional
+  // arguments below keep their meaning.
+  int positional = 1;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--", 2) != 0) {
+      argv[positional++] = argv[i];
+    }
+    else if (strcmp(argv[i], "--rcvbuf-auto") == 0) {
+      controlData.rcvbufAuto = true;
+    }
+    else if (strcmp(argv[i], "--embed-broker") == 0) {
+      embedBroker = true;
+    }
+    else if (strncmp(argv[i], "--log-level=", 12) == 0) {
+      int level;
+      if (parseLogLevel(argv[i] + 12, &level)) {
+        setLogLevel(level);
+      }
+      else {
+        cout << "Unknown log level " << argv[i] + 12 << endl;
+      }
+    }
+    else if (strncmp(argv[i], "--stats-port=", 13) == 0) {
+      statsPort = atoi(argv[i] + 13);
+    }
+    else if (strncmp(argv[i], "--flight-recorder=", 18) == 0) {
+      flightFile = argv[i] + 18;
+    }
+    else if (strcmp(argv[i], "--perf-counters") == 0) {
+      controlData.perfCounters = true;
+    }
+    else if (strcmp(argv[i], "--frame-pacing=vsync") == 0) {
+      graphicsData.framePacing = GRAPHICS_PACING_VSYNC;
+    }
+    else if (strcmp(argv[i], "--frame-pacing=capped") == 0) {
+      graphicsData.framePacing = GRAPHICS_PACING_CAPPED;
+    }
+    else if (strcmp(argv[i], "--frame-pacing=latched") == 0) {
+      graphicsData.framePacing = GRAPHICS_PACING_LATCHED;
+    }
+    else if (strncmp(argv[i], "--frame-rate=", 13) == 0) {
+      double rate = atof(argv[i] + 13);
+      if (rate > 0.0) {
+        graphicsData.frameRateCap = rate;
+      }
+    }
+    else if (strcmp(argv[i], "--gl-finish") == 0) {
+      graphicsData.finishAfterSwap = true;
+    }
+    else if (strcmp(argv[i], "--predict=velocity") == 0) {
+      graphicsData.prediction = GRAPHICS_PREDICT_VELOCITY;
+    }
+    else if (strcmp(argv[i], "--predict=acceleration") == 0) {
+      graphicsData.prediction = GRAPHICS_PREDICT_ACCELERATION;
+    }
+    else if (strncmp(argv[i], "--predict-horizon=", 18) == 0) {
+      graphicsData.predictionHorizon = atof(argv[i] + 18)*1e-3;
+    }
+    else if (strncmp(argv[i], "--predict-filter=", 17) == 0) {
+      double filter = atof(argv[i] + 17)*1e-3;
+      if (filter > 0.0) {
+        graphicsData.predictionFilter = filter;
+      }
+    }
+    else if (strncmp(argv[i], "--trace-file=", 13) == 0) {
+      setTraceFile(argv[i] + 13);
+    }
+    else if (strcmp(argv[i], "--record-ticks") == 0) {
+      controlData.recordTicks = true;
+    }
+    else if (strcmp(argv[i], "--record-compress") == 0) {
+      setRecorderCompression(true);
+    }
+    else if (strcmp(argv[i], "--segment-per-trial") == 0) {
+      segmentPerTrial = true;
+    }
+    else if (strncmp(argv[i], "--segment-size=", 15) == 0) {
+      segmentBytes = strtoull(argv[i] + 15, NULL, 10) << 20;
+    }
+    else if (strcmp(argv[i], "--record-sync=never") == 0) {
+      setRecorderSyncPolicy(RECORDER_SYNC_NEVER);
+    }
+    else if (strcmp(argv[i], "--record-sync=close") == 0) {
+      setRecorderSyncPolicy(RECORDER_SYNC_ON_CLOSE);
+    }
+    else if (strcmp(argv[i], "--record-sync=periodic") == 0) {
+      setRecorderSyncPolicy(RECORDER_SYNC_PERIODIC);
+    }
+    else if (strcmp(argv[i], "--record-sync=buffer") == 0) {
+      setRecorderSyncPolicy(RECORDER_SYNC_EVERY_BUFFER);
+    }
+    else {
+      cout << "Unknown option " << argv[i] << endl;
+    }
+  }
+  argc = positional;
+  setRecorderSegmentation(segmentPerTrial, segmentBytes);
+  if (flightFile != "off") {
+    openFlightRecorder(flightFile.c_str());
+  }
 
   // TODO: Set these IP addresses from a config file
   controlData.MODULE_NUM = 1;
@@ -77,7 +203,19 @@ int main(int argc, char* argv[])
     controlData.MH_IP = argv[3];
     controlData.MH_PORT = atoi(argv[4]);
   }
-  controlData.client = new rpc::client(controlData.MH_IP, controlData.MH_PORT);
+  controlData.broker = NULL;
+  controlData.client = NULL;
+  if (embedBroker) {
+    // Host MessageHandler in this process on the usual address, so other modules connect to it
+    // exactly as they would to the standalone messageHandler.
+    debug_log(__FILE__, __LINE__, __FUNCTION__, "Starting embedded MessageHandler");
+    controlData.broker = new MessageHandler(controlData.MH_IP, controlData.MH_PORT);
+    controlData.broker->bindMethods();
+    controlData.broker->getServer()->async_run(2);
+  }
+  else {
+    controlData.client = new rpc::client(controlData.MH_IP, controlData.MH_PORT);
+  }
   controlData.hapticsOnly = false;
   
   if (controlData.hapticsOnly == false) {
@@ -121,58 +259,68 @@ int main(int argc, char* argv[])
   }
   debug_log(__FILE__, __LINE__, __FUNCTION__, "Subscribe to Trial Control successful");
 
+  debug_log(__FILE__, __LINE__, __FUNCTION__, "*** Starting Publisher ***");
+  startPublisher();
+  debug_log(__FILE__, __LINE__, __FUNCTION__, "Publisher started");
+
+  debug_log(__FILE__, __LINE__, __FUNCTION__, "*** Starting Recorder ***");
+  startRecorder();
+  debug_log(__FILE__, __LINE__, __FUNCTION__, "Recorder started");
+
+  debug_log(__FILE__, __LINE__, __FUNCTION__, "*** Starting Statistics ***");
+  startStats(controlData.IPADDR, statsPort);
+  debug_log(__FILE__, __LINE__, __FUNCTION__, "Statistics started");
+
   debug_log(__FILE__, __LINE__, __FUNCTION__, "*** Starting Streamer and Listener ***");
   platform::sleep(2);
   startStreamer(); 
   startListener();
   debug_log(__FILE__, __LINE__, __FUNCTION__, "Streamer and listener started");
 
+  // Rendering runs on its own thread from here on. The main thread only waits for window events,
+  // which GLFW requires to be handled here.
+  startRenderThread();
+  debug_log(__FILE__, __LINE__, __FUNCTION__, "Render thread started");
   while (!glfwWindowShouldClose(graphicsData.window)) {
-    // debug_log(__FILE__, __LINE__, __FUNCTION__, "Main loop iteration");
-    try {
-      glfwGetWindowSize(graphicsData.window, &graphicsData.width, &graphicsData.height);
-      graphicsData.graphicsClock = clock();
-      updateGraphics();
-      glfwPollEvents();
-      graphicsData.freqCounterGraphics.signal(1);
-    } catch (const std::exception& e) {
-      debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("Exception in main loop: " + std::string(e.what())).c_str());
-      print_stack_trace();
-      throw;
-    } catch (...) {
-      debug_log(__FILE__, __LINE__, __FUNCTION__, "Unknown exception in main loop");
-      print_stack_trace();
-      throw;
-    }
+    glfwWaitEvents();
   }
+  close();
   
   glfwDestroyWindow(graphicsData.window);
+  graphicsData.window = NULL;
   glfwTerminate();
   return(0);
 }
 
 /**
- * Checks if the haptics and messaging threads have exited yet. The graphics loop is in main, and
- * exits when all other threads are down, so it is not checked here.
+ * Checks if the haptics, streamer, publisher and recorder threads have exited yet. The listener is
+ * not checked because it may be the thread calling close, and the render thread is not checked
+ * because close stops it itself once these are down, before deleting the world it draws.
  */
 bool allThreadsDown()
 {
-  return (controlData.hapticsUp && controlData.listenerUp && controlData.streamerUp);  
+  return (!controlData.hapticsUp && !controlData.streamerUp && !controlData.publisherUp
+    && !controlData.recorderUp);
 }
 
 /**
- * Ends the program. This method does so by setting the "simulationRunning" boolean to false. When
- * false, other threads will exit. To exit gracefully, this method waits until all threads have
- * returned before stopping the haptic tool and exiting the graphic interface.
+ * Does the work of close. Only ever called through close, which runs it once.
  */
-void close()
+static void tearDown()
 {
   debug_log(__FILE__, __LINE__, __FUNCTION__, "Starting application close");
+  stopRecording();
   controlData.simulationRunning = false;
   while (!controlData.simulationFinished) {
     controlData.simulationFinished = allThreadsDown();
-    platform::sleep(100);
+    platform::usleep(1000);
+  }
+  stopStats();
+  if (isTraceEnabled()) {
+    dumpTrace(NULL);
   }
+  stopRenderThread();
+  debug_log(__FILE__, __LINE__, __FUNCTION__, "Render thread stopped");
   try {
     hapticsData.tool->stop();
     debug_log(__FILE__, __LINE__, __FUNCTION__, "Haptic tool stopped");
@@ -183,12 +331,36 @@ void close()
     delete hapticsData.handler;
     debug_log(__FILE__, __LINE__, __FUNCTION__, "Deleted handler");
     closeMessagingSocket();
-    graphicsData.world->deleteAllChildren();
   } catch (const std::exception& e) {
-    debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("Exception during close: " + std::string(e.what())).c_str());
+    LOG_ERROR("Exception during close: %s", e.what());
+    flushLogger();
     print_stack_trace();
     throw;
   }
+  closeFlightRecorder();
+  stopLogger();
+  // When called from the listener, main is blocked in glfwWaitEvents; wake it so it destroys the
+  // window and exits. Once main has destroyed the window there is nobody left to wake.
+  if (graphicsData.window != NULL) {
+    glfwSetWindowShouldClose(graphicsData.window, GLFW_TRUE);
+    glfwPostEmptyEvent();
+  }
+}
+
+/**
+ * Ends the program. This method does so by setting the "simulationRunning" boolean to false. When
+ * false, other threads will exit. To exit gracefully, this method waits until all threads have
+ * returned, stops the render thread, and only then stops the haptic tool and deletes the world.
+ * Finally it asks the main thread to close the window.
+ *
+ * The teardown runs once. close is reached from SESSION_END on the listener thread, from main
+ * when the window closes, and from atexit; later callers wait for the first to finish and then
+ * return without doing anything.
+ */
+void close()
+{
+  static once_flag closeOnce;
+  call_once(closeOnce, tearDown);
 }
 
 /**
@@ -198,23 +370,26 @@ void close()
  */
 void parsePacket(char* packet)
 {
-  debug_log(__FILE__, __LINE__, __FUNCTION__, "Parsing packet");
   try {
     MSG_HEADER header;
     memcpy(&header, packet, sizeof(header));
     int msgType = header.msg_type;
-    debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("Message type: " + std::to_string(msgType)).c_str());
+    LOG_TRACE("Parsing packet of type %d", msgType);
+    TRACE_ZONE_MESSAGE("parsePacket", header.serial_no, msgType);
+    TRACE_MESSAGE_END(header.serial_no, msgType);
+    double parseStart = getSteadyTime();
     switch (msgType)
     {
       case SESSION_START:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received SESSION_START Message");
+        LOG_DEBUG("Received SESSION_START Message");
+        resetMessageLatencies();
         break;
       }
 
       case SESSION_END:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received SESSION_END Message");
+        LOG_DEBUG("Received SESSION_END Message");
         controlData.simulationRunning = false;
         close();
         break;
@@ -222,46 +397,73 @@ void parsePacket(char* packet)
 
       case TRIAL_START:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received TRIAL_START Message");
+        LOG_DEBUG("Received TRIAL_START Message");
+        M_TRIAL_START trialStart;
+        memcpy(&trialStart, packet, sizeof(trialStart));
+        markTrialStart(trialStart.trialNum);
         break;
       }
 
       case TRIAL_END:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received TRIAL_END Message");
+        LOG_DEBUG("Received TRIAL_END Message");
+        markTrialEnd();
         break;
       }
 
       case START_RECORDING:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received START_RECORDING Message");
+        LOG_DEBUG("Received START_RECORDING Message");
         M_START_RECORDING recInfo;
         memcpy(&recInfo, packet, sizeof(recInfo));
-        char* fileName;
-        fileName = recInfo.filename;
-        controlData.dataFile.open(fileName, ofstream::binary);
-        controlData.dataFile.flush();
-        controlData.loggingData = true;
+        recInfo.filename[MAX_STRING_LENGTH - 1] = '\0';
+        startRecording(recInfo.filename);
         break; 
       }
 
       case STOP_RECORDING:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received STOP_RECORDING Message");
-        controlData.dataFile.close();
-        controlData.loggingData = false;
+        LOG_DEBUG("Received STOP_RECORDING Message");
+        stopRecording();
+        break;
+      }
+
+      case PAUSE_RECORDING:
+      {
+        LOG_DEBUG("Received PAUSE_RECORDING Message");
+        pauseRecording();
+        break;
+      }
+
+      case RESUME_RECORDING:
+      {
+        LOG_DEBUG("Received RESUME_RECORDING Message");
+        resumeRecording();
+        break;
+      }
+
+      case DUMP_TRACE:
+      {
+        LOG_DEBUG("Received DUMP_TRACE Message");
+        M_DUMP_TRACE dumpInfo;
+        memcpy(&dumpInfo, packet, sizeof(dumpInfo));
+        dumpInfo.filename[MAX_STRING_LENGTH - 1] = '\0';
+        if (isTraceEnabled()) {
+          dumpTrace(dumpInfo.filename);
+        }
+        else {
+          LOG_WARN("Tracing is not compiled in; build with HAPTIC_TRACE");
+        }
         break;
       }
       
       case REMOVE_OBJECT:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received REMOVE_OBJECT Message");
+        LOG_DEBUG("Received REMOVE_OBJECT Message");
         M_REMOVE_OBJECT rmObj;
         memcpy(&rmObj, packet, sizeof(rmObj));
         if (controlData.objectMap.find(rmObj.objectName) == controlData.objectMap.end()) {
-          std::stringstream ss;
-          ss << rmObj.objectName << " not found";
-          debug_log(__FILE__, __LINE__, __FUNCTION__, ss.str().c_str());
+          LOG_WARN("%s not found", rmObj.objectName);
         }
         else {
           cGenericObject* objPtr = controlData.objectMap[rmObj.objectName];
@@ -273,7 +475,7 @@ void parsePacket(char* packet)
       
       case RESET_WORLD:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received RESET_WORLD Message");
+        LOG_DEBUG("Received RESET_WORLD Message");
         unordered_map<string, cGenericObject*>::iterator objIt = controlData.objectMap.begin();
         while (objIt != controlData.objectMap.end()) {
           bool removedObj = graphicsData.world->deleteChild(objIt->second);
@@ -292,7 +494,7 @@ void parsePacket(char* packet)
 
       case CST_CREATE:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received CST_CREATE Message");
+        LOG_DEBUG("Received CST_CREATE Message");
         M_CST_CREATE cstObj;
         memcpy(&cstObj, packet, sizeof(cstObj));
         cCST* cst = new cCST(graphicsData.world, cstObj.lambdaVal, 
@@ -306,13 +508,11 @@ void parsePacket(char* packet)
       }
       case CST_DESTRUCT:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received CST_DESTRUCT Message");
+        LOG_DEBUG("Received CST_DESTRUCT Message");
         M_CST_DESTRUCT cstObj;
         memcpy(&cstObj, packet, sizeof(cstObj));
         if (controlData.objectMap.find(cstObj.cstName) == controlData.objectMap.end()) {
-          std::stringstream ss;
-          ss << cstObj.cstName << " not found";
-          debug_log(__FILE__, __LINE__, __FUNCTION__, ss.str().c_str());
+          LOG_WARN("%s not found", cstObj.cstName);
         }
         else {
           cCST* cst = dynamic_cast<cCST*>(controlData.objectMap[cstObj.cstName]);
@@ -326,7 +526,7 @@ void parsePacket(char* packet)
       }
       case CST_START:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received CST_START Message");
+        LOG_DEBUG("Received CST_START Message");
         M_CST_START cstObj;
         memcpy(&cstObj, packet, sizeof(cstObj));
         cCST* cst = dynamic_cast<cCST*>(controlData.objectMap[cstObj.cstName]);
@@ -336,7 +536,7 @@ void parsePacket(char* packet)
       }
       case CST_STOP:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received CST_STOP Message");
+        LOG_DEBUG("Received CST_STOP Message");
         M_CST_STOP cstObj;
         memcpy(&cstObj, packet, sizeof(cstObj));
         cCST* cst = dynamic_cast<cCST*>(controlData.objectMap[cstObj.cstName]);
@@ -346,7 +546,7 @@ void parsePacket(char* packet)
       }
       case CST_SET_VISUAL:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received CST_SET_VISUAL Message");
+        LOG_DEBUG("Received CST_SET_VISUAL Message");
         M_CST_SET_VISUAL cstObj;
         memcpy(&cstObj, packet, sizeof(cstObj));
         bool visual = cstObj.visionEnabled;
@@ -356,7 +556,7 @@ void parsePacket(char* packet)
       }
       case CST_SET_HAPTIC:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received CST_SET_HAPTIC Message");
+        LOG_DEBUG("Received CST_SET_HAPTIC Message");
         M_CST_SET_HAPTIC cstObj;
         memcpy(&cstObj, packet, sizeof(cstObj));
         bool haptic = cstObj.hapticEnabled;
@@ -366,7 +566,7 @@ void parsePacket(char* packet)
       }
       case CST_SET_LAMBDA:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received CST_SET_LAMBDA Message");
+        LOG_DEBUG("Received CST_SET_LAMBDA Message");
         M_CST_SET_LAMBDA cstObj;
         memcpy(&cstObj, packet, sizeof(cstObj));
         double lambda = cstObj.lambdaVal;
@@ -376,7 +576,7 @@ void parsePacket(char* packet)
       }
       case CUPS_CREATE:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received CUPS_CREATE Message");
+        LOG_DEBUG("Received CUPS_CREATE Message");
         M_CUPS_CREATE createCups;
         memcpy(&createCups, packet, sizeof(createCups));
         cCups* cups = new cCups(graphicsData.world, createCups.escapeAngle, 
@@ -390,13 +590,11 @@ void parsePacket(char* packet)
       }
       case CUPS_DESTRUCT:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received CUPS_DESTRUCT Message");
+        LOG_DEBUG("Received CUPS_DESTRUCT Message");
         M_CUPS_DESTRUCT cupsObj;
         memcpy(&cupsObj, packet, sizeof(cupsObj));
         if (controlData.objectMap.find(cupsObj.cupsName) == controlData.objectMap.end()) {
-          std::stringstream ss;
-          ss << cupsObj.cupsName << " not found";
-          debug_log(__FILE__, __LINE__, __FUNCTION__, ss.str().c_str());
+          LOG_WARN("%s not found", cupsObj.cupsName);
         }
         else {
           cCups* cups = dynamic_cast<cCups*>(controlData.objectMap[cupsObj.cupsName]);
@@ -410,7 +608,7 @@ void parsePacket(char* packet)
       }
       case CUPS_START:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received CUPS_START Message");
+        LOG_DEBUG("Received CUPS_START Message");
         M_CUPS_START cupsObj;
         memcpy(&cupsObj, packet, sizeof(cupsObj));
         cCups* cups = dynamic_cast<cCups*>(controlData.objectMap[cupsObj.cupsName]);
@@ -420,7 +618,7 @@ void parsePacket(char* packet)
       }
       case CUPS_STOP:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received CUPS_STOP Message");
+        LOG_DEBUG("Received CUPS_STOP Message");
         M_CUPS_STOP cupsObj;
         memcpy(&cupsObj, packet, sizeof(cupsObj));
         cCups* cups = dynamic_cast<cCups*>(controlData.objectMap[cupsObj.cupsName]);
@@ -430,15 +628,13 @@ void parsePacket(char* packet)
       }
       case HAPTICS_SET_ENABLED:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received HAPTICS_SET_ENABLED Message");
+        LOG_DEBUG("Received HAPTICS_SET_ENABLED Message");
         M_HAPTICS_SET_ENABLED hapticsEnabled;
         memcpy(&hapticsEnabled, packet, sizeof(hapticsEnabled));
         char* objectName;
         objectName = hapticsEnabled.objectName;
         if (controlData.objectMap.find(objectName) == controlData.objectMap.end()) {
-          std::stringstream ss;
-          ss << objectName << " not found";
-          debug_log(__FILE__, __LINE__, __FUNCTION__, ss.str().c_str());
+          LOG_WARN("%s not found", objectName);
         }
         else {
           if (hapticsEnabled.enabled == 1) {
@@ -462,17 +658,24 @@ void parsePacket(char* packet)
         break; 
       }
 
+      case HAPTICS_SET_STREAM_RATE:
+      {
+        LOG_DEBUG("Received HAPTICS_SET_STREAM_RATE Message");
+        M_HAPTICS_SET_STREAM_RATE rateMsg;
+        memcpy(&rateMsg, packet, sizeof(rateMsg));
+        setStreamRate(rateMsg.rate);
+        break;
+      }
+
       case HAPTICS_SET_STIFFNESS:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received HAPTICS_SET_STIFFNESS Message");
+        LOG_DEBUG("Received HAPTICS_SET_STIFFNESS Message");
         M_HAPTICS_SET_STIFFNESS stiffness;
         memcpy(&stiffness, packet, sizeof(stiffness));
         char* objectName;
         objectName = stiffness.objectName;
         if (controlData.objectMap.find(objectName) == controlData.objectMap.end()) {
-          std::stringstream ss;
-          ss << objectName << " not found";
-          debug_log(__FILE__, __LINE__, __FUNCTION__, ss.str().c_str());
+          LOG_WARN("%s not found", objectName);
         }
         else {
           controlData.objectMap[objectName]->m_material->setStiffness(stiffness.stiffness);
@@ -482,7 +685,7 @@ void parsePacket(char* packet)
 
       case HAPTICS_BOUNDING_PLANE:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received HAPTICS_BOUNDING_PLANE Message");
+        LOG_DEBUG("Received HAPTICS_BOUNDING_PLANE Message");
         M_HAPTICS_BOUNDING_PLANE bpMsg;
         memcpy(&bpMsg, packet, sizeof(bpMsg));
         double bWidth = bpMsg.bWidth;
@@ -502,7 +705,7 @@ void parsePacket(char* packet)
       
       case HAPTICS_CONSTANT_FORCE_FIELD:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received HAPTICS_CONSTANT_FORCE_FIELD Message");
+        LOG_DEBUG("Received HAPTICS_CONSTANT_FORCE_FIELD Message");
         M_HAPTICS_CONSTANT_FORCE_FIELD cffInfo;
         memcpy(&cffInfo, packet, sizeof(cffInfo));
         double d = cffInfo.direction;
@@ -515,7 +718,7 @@ void parsePacket(char* packet)
 
       case HAPTICS_VISCOSITY_FIELD:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received HAPTICS_VISCOSITY_FIELD Message");
+        LOG_DEBUG("Received HAPTICS_VISCOSITY_FIELD Message");
         M_HAPTICS_VISCOSITY_FIELD vF;
         memcpy(&vF, packet, sizeof(vF));
         cMatrix3d* B = new cMatrix3d(vF.viscosityMatrix[0], vF.viscosityMatrix[1], vF.viscosityMatrix[2],
@@ -529,7 +732,7 @@ void parsePacket(char* packet)
       
       case HAPTICS_FREEZE_EFFECT:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received HAPTICS_FREEZE_EFFECT Message");
+        LOG_DEBUG("Received HAPTICS_FREEZE_EFFECT Message");
         M_HAPTICS_FREEZE_EFFECT freeze;
         memcpy(&freeze, packet, sizeof(freeze));
         double workspaceScaleFactor = hapticsData.tool->getWorkspaceScaleFactor();
@@ -543,7 +746,7 @@ void parsePacket(char* packet)
 
       case HAPTICS_REMOVE_WORLD_EFFECT:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received HAPTICS_REMOVE_FIELD_EFFECT Message");
+        LOG_DEBUG("Received HAPTICS_REMOVE_FIELD_EFFECT Message");
         M_HAPTICS_REMOVE_WORLD_EFFECT rmField;
         memcpy(&rmField, packet, sizeof(rmField));
         cGenericEffect* fieldEffect = controlData.worldEffects[rmField.effectName];
@@ -554,16 +757,14 @@ void parsePacket(char* packet)
 
       case GRAPHICS_SET_ENABLED:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received GRAPHICS_SET_ENABLED Message");
+        LOG_DEBUG("Received GRAPHICS_SET_ENABLED Message");
         M_GRAPHICS_SET_ENABLED graphicsEnabled;
         memcpy(&graphicsEnabled, packet, sizeof(graphicsEnabled));
         char* objectName;
         objectName = graphicsEnabled.objectName;
         int enabled = graphicsEnabled.enabled;
         if (controlData.objectMap.find(objectName) == controlData.objectMap.end()) {
-          std::stringstream ss;
-          ss << objectName << " not found";
-          debug_log(__FILE__, __LINE__, __FUNCTION__, ss.str().c_str());
+          LOG_WARN("%s not found", objectName);
         }
         else {
           if (graphicsEnabled.enabled == 1) {
@@ -578,7 +779,7 @@ void parsePacket(char* packet)
       
       case GRAPHICS_CHANGE_BG_COLOR:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received GRAPHICS_CHANGE_BG_COLOR Message");
+        LOG_DEBUG("Received GRAPHICS_CHANGE_BG_COLOR Message");
         M_GRAPHICS_CHANGE_BG_COLOR bgColor;
         memcpy(&bgColor, packet, sizeof(bgColor));
         float red = bgColor.color[0]/250.0;
@@ -590,7 +791,7 @@ void parsePacket(char* packet)
       
       case GRAPHICS_PIPE:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received GRAPHICS_PIPE Message");
+        LOG_DEBUG("Received GRAPHICS_PIPE Message");
         M_GRAPHICS_PIPE pipe;
         memcpy(&pipe, packet, sizeof(pipe));
         cVector3d* position = new cVector3d(pipe.position[0], pipe.position[1], pipe.position[2]);
@@ -607,7 +808,7 @@ void parsePacket(char* packet)
 
       case GRAPHICS_ARROW:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received GRAPHICS_ARROW Message");
+        LOG_DEBUG("Received GRAPHICS_ARROW Message");
         M_GRAPHICS_ARROW arrow;
         memcpy(&arrow, packet, sizeof(arrow));
         cVector3d* direction = new cVector3d(arrow.direction[0], arrow.direction[1], arrow.direction[2]);
@@ -622,7 +823,7 @@ void parsePacket(char* packet)
       
       case GRAPHICS_CHANGE_OBJECT_COLOR:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received GRAPHICS_CHANGE_OBJECT_COLOR Message");
+        LOG_DEBUG("Received GRAPHICS_CHANGE_OBJECT_COLOR Message");
         M_GRAPHICS_CHANGE_OBJECT_COLOR color;
         memcpy(&color, packet, sizeof(color));
         cGenericObject* obj = controlData.objectMap[color.objectName];
@@ -631,7 +832,7 @@ void parsePacket(char* packet)
       }
       case GRAPHICS_MOVING_DOTS:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received GRAPHICS_MOVING_DOTS Message");
+        LOG_DEBUG("Received GRAPHICS_MOVING_DOTS Message");
         cMultiPoint* test = new cMultiPoint();
         M_GRAPHICS_MOVING_DOTS dots;
         memcpy(&dots, packet, sizeof(dots));
@@ -646,7 +847,7 @@ void parsePacket(char* packet)
       }
       case GRAPHICS_SHAPE_BOX:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received GRAPHICS_SHAPE_BOX Message");
+        LOG_DEBUG("Received GRAPHICS_SHAPE_BOX Message");
         M_GRAPHICS_SHAPE_BOX box;
         memcpy(&box, packet, sizeof(box));
         cShapeBox* boxObj = new cShapeBox(box.sizeX, box.sizeY, box.sizeZ);
@@ -658,7 +859,7 @@ void parsePacket(char* packet)
       }
       case GRAPHICS_SHAPE_SPHERE: 
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received GRAPHICS_SHAPE_SPHERE Message");
+        LOG_DEBUG("Received GRAPHICS_SHAPE_SPHERE Message");
         M_GRAPHICS_SHAPE_SPHERE sphere;
         memcpy(&sphere, packet, sizeof(sphere));
         cShapeSphere* sphereObj = new cShapeSphere(sphere.radius);
@@ -670,7 +871,7 @@ void parsePacket(char* packet)
       }
       case GRAPHICS_SHAPE_TORUS:
       {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Received GRAPHICS_SHAPE_TORUS Message");
+        LOG_DEBUG("Received GRAPHICS_SHAPE_TORUS Message");
         M_GRAPHICS_SHAPE_TORUS torus;
         memcpy(&torus, packet, sizeof(torus));
         cShapeTorus* torusObj = new cShapeTorus(torus.innerRadius, torus.outerRadius);
@@ -684,8 +885,9 @@ void parsePacket(char* packet)
         break; 
       }
     }
+    statsMessageParsed(header, parseStart, getSteadyTime());
   } catch (const std::exception& e) {
-    debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("Exception in parsePacket: " + std::string(e.what())).c_str());
+    LOG_ERROR("Exception in parsePacket: %s", e.what());
     print_stack_trace();
     throw;
   }
@@ -12,6 +12,8 @@
 #include "network/network.h"
 #include "network/streamer.h"
 #include "network/listener.h"
+#include "network/publisher.h"
+#include "recording/recorder.h"
 #include "haptics/haptics.h"
 #include "graphics/graphics.h"
 #include "combined/combined.h"
@@ -22,15 +24,21 @@
 using namespace chai3d;
 using namespace std;
 
+class MessageHandler;
+
 struct ControlData
 {
   // State variables
   bool simulationRunning;
   bool simulationFinished;
-  bool hapticsUp;
-  bool listenerUp;
-  bool streamerUp;
-  bool loggingData;
+  atomic<bool> hapticsUp; // each thread clears its flag as it exits; close waits on them
+  atomic<bool> listenerUp;
+  atomic<bool> streamerUp;
+  atomic<bool> publisherUp;
+  atomic<bool> recorderUp;
+  atomic<double> streamRate; // haptic data stream rate in Hz
+  atomic<bool> recordTicks; // record every haptic tick from the haptic thread instead of the streamed samples
+  bool perfCounters; // count cycles, cache misses and context switches per haptic phase (Linux)
   
   // Messaging and Data Logging Variables
   //const char* SENDER_IP;
@@ -38,9 +46,11 @@ struct ControlData
   const char* IPADDR;
   int PORT;
   int msg_socket;
+  bool rcvbufAuto; // grow the socket receive buffer to absorb listener stalls
   const char* MH_IP;
   int MH_PORT;
   rpc::client* client;
+  MessageHandler* broker; // in-process MessageHandler with --embed-broker, NULL otherwise
   
   //const char* LISTENER_IP;
   //int LISTENER_PORT;
@@ -51,7 +61,8 @@ struct ControlData
   //int listener_socket;
   cThread* streamerThread; // for streaming haptic data only
   cThread* listenerThread;
-  ofstream dataFile;
+  cThread* publisherThread; // only thread that uses the rpc client after startup
+  cThread* recorderThread; // writes recordings to disk
 
   // TODO: Make the hapticsOnly = true mode actually work
   bool hapticsOnly;
@@ -7,8 +7,9 @@
 
 // Debug logging function implementation
 void debug_log(const char* file, int line, const char* func, const char* msg) {
-    std::cout << "[DEBUG] " << file << ":" << line << " in " << func << ": " << msg << std::endl;
-    std::cout.flush();
+    if (LOG_LEVEL_DEBUG >= LOG_LEVEL_FLOOR) {
+        logWrite(LOG_LEVEL_DEBUG, file, line, func, "%s", msg);
+    }
 }
 
 // Stack trace handler for Windows
@@ -4,8 +4,9 @@
 #define _DEBUG_H_
 
 #include <string>
+#include "logger.h"
 
-// Debug logging function declaration
+// Logs msg at debug level through the asynchronous logger, see logger.h
 void debug_log(const char* file, int line, const char* func, const char* msg);
 
 // Stack trace function declaration
@@ -0,0 +1,206 @@
+#include "flightRecorder.h"
+
+#include "core/debug.h"
+#include "core/timing.h"
+#include "haptics/haptics.h"
+#include "network/publisher.h"
+#include "platform_compat.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+using namespace std;
+
+/**
+ * @file flightRecorder.h
+ * @file flightRecorder.cpp
+ * @brief Crash-safe record of the last seconds of haptic ticks, messages and frames
+ *
+ * The flight recorder file (layout in flightRecorderFormat.h) is mapped into memory when the
+ * program starts and written in place from then on: the haptic thread stores every tick, the
+ * listener every packet it reads and the graphics thread every frame. Each thread owns its ring,
+ * so a store is a copy into the next entry followed by one atomic increment, without locks or
+ * system calls. The operating system writes the dirty pages back in its own time.
+ *
+ * Nothing needs to happen when the program dies: the data is already in the page cache. The
+ * signal handler only marks the header as crashed, which is a few stores. If the previous run did
+ * not close normally, its file is kept as <file>.prev so a quick restart does not overwrite it.
+ * Read the file with the flightRecorderDump tool.
+ *
+ * The mapping is never removed, so threads that are still running while the program shuts down
+ * can keep writing safely.
+ */
+
+static FlightHeader* header = NULL;
+static FlightTick* tickRing = NULL;
+static FlightMessage* messageRing = NULL;
+static FlightFrame* frameRing = NULL;
+
+static void initRing(FlightRing* ring, uint32_t entrySize, uint32_t capacity, uint64_t offset)
+{
+  ring->written.store(0, memory_order_relaxed);
+  ring->entrySize = entrySize;
+  ring->capacity = capacity;
+  ring->offset = offset;
+}
+
+/**
+ * Moves the file aside if it holds a run that did not close normally.
+ */
+static void keepUnclosedRun(const char* path)
+{
+  FILE* previous = fopen(path, "rb");
+  if (previous == NULL) {
+    return;
+  }
+  char buffer[sizeof(FlightHeader)];
+  size_t length = fread(buffer, 1, sizeof(buffer), previous);
+  fclose(previous);
+  if (length < sizeof(buffer) || memcmp(buffer, FLIGHT_MAGIC, 8) != 0) {
+    return;
+  }
+  uint32_t state;
+  memcpy(&state, buffer + offsetof(FlightHeader, state), sizeof(state));
+  if (state != FLIGHT_STATE_CLOSED) {
+    string kept = flightPreviousPath(path);
+    remove(kept.c_str());
+    if (rename(path, kept.c_str()) == 0) {
+      LOG_WARN("The previous run did not close normally; its flight recorder was kept as %s", kept);
+    }
+  }
+}
+
+/**
+ * @param path File to map
+ *
+ * Creates the flight recorder file and maps it. Returns false, and leaves the flight recorder off,
+ * if the file could not be created.
+ */
+bool openFlightRecorder(const char* path)
+{
+  keepUnclosedRun(path);
+  char* base = (char*) platform::mapFileForWrite(path, FLIGHT_FILE_SIZE);
+  if (base == NULL) {
+    LOG_ERROR("Could not create flight recorder file %s", path);
+    return false;
+  }
+  memset(base, 0, FLIGHT_FILE_SIZE); // fault every page in now rather than in the haptic loop
+  FlightHeader* h = (FlightHeader*) base;
+  memcpy(h->magic, FLIGHT_MAGIC, 8);
+  h->version = FLIGHT_VERSION;
+  h->signal = 0;
+  h->pid = platform::getProcessId();
+  h->startTime = (int64_t) time(NULL);
+  h->stopTime = 0.0;
+  h->clockOffset = toMessageHandlerTime(0.0);
+  initRing(&h->ticks, sizeof(FlightTick), FLIGHT_TICK_ENTRIES, FLIGHT_TICKS_OFFSET);
+  initRing(&h->messages, sizeof(FlightMessage), FLIGHT_MESSAGE_ENTRIES, FLIGHT_MESSAGES_OFFSET);
+  initRing(&h->frames, sizeof(FlightFrame), FLIGHT_FRAME_ENTRIES, FLIGHT_FRAMES_OFFSET);
+  h->state = FLIGHT_STATE_RUNNING;
+  tickRing = (FlightTick*) (base + FLIGHT_TICKS_OFFSET);
+  messageRing = (FlightMessage*) (base + FLIGHT_MESSAGES_OFFSET);
+  frameRing = (FlightFrame*) (base + FLIGHT_FRAMES_OFFSET);
+  header = h;
+  LOG_INFO("Flight recorder writing to %s", path);
+  return true;
+}
+
+/**
+ * Marks the run as closed normally.
+ */
+void closeFlightRecorder(void)
+{
+  if (header == NULL) {
+    return;
+  }
+  header->stopTime = getSteadyTime();
+  header->state = FLIGHT_STATE_CLOSED;
+}
+
+/**
+ * @param sig Signal being handled
+ *
+ * Marks the run as crashed. Safe to call from a signal handler.
+ */
+void flightRecorderCrash(int sig)
+{
+  if (header == NULL) {
+    return;
+  }
+  header->signal = sig;
+  header->stopTime = getSteadyTime();
+  header->state = FLIGHT_STATE_CRASHED;
+}
+
+/**
+ * @param sample State of the tool at the end of the tick
+ * @param duration Time the tick's work took
+ *
+ * Called once per tick from the haptic thread.
+ */
+void flightRecordTick(const HapticSample& sample, double duration)
+{
+  if (header == NULL) {
+    return;
+  }
+  uint64_t written = header->ticks.written.load(memory_order_relaxed);
+  FlightTick& entry = tickRing[written & (FLIGHT_TICK_ENTRIES - 1)];
+  entry.tick = sample.tick;
+  entry.time = sample.time;
+  entry.duration = duration;
+  memcpy(entry.pos, sample.pos, sizeof(entry.pos));
+  memcpy(entry.vel, sample.vel, sizeof(entry.vel));
+  memcpy(entry.force, sample.force, sizeof(entry.force));
+  header->ticks.written.store(written + 1, memory_order_release);
+}
+
+/**
+ * @param packet Packet as read from the socket
+ * @param length Bytes read
+ * @param receiveTime getSteadyTime at which it was read
+ *
+ * Called from the listener for every packet.
+ */
+void flightRecordMessage(const char* packet, int length, double receiveTime)
+{
+  if (header == NULL) {
+    return;
+  }
+  MSG_HEADER msgHeader;
+  memcpy(&msgHeader, packet, sizeof(msgHeader));
+  uint64_t written = header->messages.written.load(memory_order_relaxed);
+  FlightMessage& entry = messageRing[written & (FLIGHT_MESSAGE_ENTRIES - 1)];
+  entry.time = receiveTime;
+  entry.sentTime = msgHeader.timestamp;
+  entry.msgType = msgHeader.msg_type;
+  entry.serialNo = msgHeader.serial_no;
+  entry.sourceModule = msgHeader.source_module;
+  entry.length = length;
+  size_t kept = (length < FLIGHT_MESSAGE_BYTES) ? (size_t) length : FLIGHT_MESSAGE_BYTES;
+  memcpy(entry.bytes, packet, kept);
+  memset(entry.bytes + kept, 0, FLIGHT_MESSAGE_BYTES - kept);
+  header->messages.written.store(written + 1, memory_order_release);
+}
+
+/**
+ * @param tick Haptic tick the frame was stamped with
+ * @param frameStart getSteadyTime at the start of the graphics loop iteration
+ * @param frameEnd getSteadyTime at its end
+ *
+ * Called once per frame from the graphics thread, which also keeps the clock offset current.
+ */
+void flightRecordFrame(uint64_t tick, double frameStart, double frameEnd)
+{
+  if (header == NULL) {
+    return;
+  }
+  uint64_t written = header->frames.written.load(memory_order_relaxed);
+  FlightFrame& entry = frameRing[written & (FLIGHT_FRAME_ENTRIES - 1)];
+  entry.frame = written;
+  entry.tick = tick;
+  entry.time = frameStart;
+  entry.duration = frameEnd - frameStart;
+  header->frames.written.store(written + 1, memory_order_release);
+  header->clockOffset = toMessageHandlerTime(0.0);
+}
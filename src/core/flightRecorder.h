@@ -0,0 +1,18 @@
+#pragma once
+
+#ifndef _FLIGHTRECORDER_H_
+#define _FLIGHTRECORDER_H_
+
+#include <stdint.h>
+#include "flightRecorderFormat.h"
+
+struct HapticSample;
+
+bool openFlightRecorder(const char* path);
+void closeFlightRecorder(void);
+void flightRecorderCrash(int sig);
+void flightRecordTick(const HapticSample& sample, double duration);
+void flightRecordMessage(const char* packet, int length, double receiveTime);
+void flightRecordFrame(uint64_t tick, double frameStart, double frameEnd);
+
+#endif
@@ -0,0 +1,476 @@
+#include "logger.h"
+
+#include "chai3d.h"
+#include "core/timing.h"
+#include "platform_compat.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace chai3d;
+using namespace std;
+
+/**
+ * @file logger.h
+ * @file logger.cpp
+ * @brief Asynchronous leveled logger
+ *
+ * A log call never formats text and never touches the terminal. It takes a slot in the calling
+ * thread's own ring and copies the format pointer, the call site and the arguments into it. String
+ * arguments are copied, everything else is stored as a 64-bit value. The ring has a single producer
+ * and a single consumer, so taking and committing a slot is a pair of atomic index updates. If the
+ * ring is full, the record is dropped and counted rather than blocking the caller.
+ *
+ * The flusher thread drains every ring every LOGGER_FLUSH_INTERVAL, orders the records by time,
+ * formats them and writes them to stdout in one write. Each thread's ring is created the first
+ * time it logs and lives until the program exits.
+ *
+ * Calls below LOG_LEVEL_FLOOR are removed by the compiler. Calls below the level set with
+ * setLogLevel return after one relaxed load.
+ */
+
+struct LogThreadBuffer
+{
+  LogRecord records[LOGGER_RING_RECORDS];
+  atomic<size_t> head{0}; // next record for the flusher
+  atomic<size_t> tail{0}; // next slot for the owning thread
+  atomic<uint64_t> dropped{0};
+  uint64_t droppedReported = 0; // flusher only
+  int threadNum = 0;
+};
+
+static const char* LOG_LEVEL_NAMES[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR"};
+
+static atomic<int> logLevel(LOG_LEVEL_DEBUG);
+static atomic<bool> loggerRunning(false);
+static atomic<uint64_t> recordsDropped(0);
+static mutex bufferListLock; // guards threadBuffers
+static vector<LogThreadBuffer*> threadBuffers;
+static mutex flushLock; // one flush at a time
+// Held while threadBuffers is changed or the rings are drained. The signal path cannot take a
+// mutex its own thread may already hold, so it claims these with exchange and gives up if taken.
+static atomic<bool> registering(false);
+static atomic<bool> flushing(false);
+static cThread* loggerThread = NULL;
+static thread_local LogThreadBuffer* localBuffer = NULL;
+
+/**
+ * Sets the flag, waiting while a signal handler on another thread holds it.
+ */
+static void claimFlag(atomic<bool>* flag)
+{
+  while (flag->exchange(true, memory_order_acquire)) {
+    this_thread::yield();
+  }
+}
+
+/**
+ * Returns the calling thread's ring, creating and registering it on first use.
+ */
+static LogThreadBuffer* getThreadBuffer()
+{
+  if (localBuffer == NULL) {
+    LogThreadBuffer* buffer = new LogThreadBuffer();
+    lock_guard<mutex> lock(bufferListLock);
+    claimFlag(&registering);
+    buffer->threadNum = (int) threadBuffers.size();
+    threadBuffers.push_back(buffer);
+    registering.store(false, memory_order_release);
+    localBuffer = buffer;
+  }
+  return localBuffer;
+}
+
+/**
+ * @param level LOG_LEVEL_* of the message
+ * @param file Source file of the call
+ * @param line Source line of the call
+ * @param func Function making the call
+ * @param format printf-style format, which must be a string literal
+ *
+ * Takes the next slot in the calling thread's ring and fills in the call site. Returns NULL if the
+ * level is filtered out or the ring is full. Call logCommit once the arguments are captured.
+ */
+LogRecord* logBegin(int level, const char* file, int line, const char* func, const char* format)
+{
+  if (level < logLevel.load(memory_order_relaxed)) {
+    return NULL;
+  }
+  LogThreadBuffer* buffer = getThreadBuffer();
+  size_t tail = buffer->tail.load(memory_order_relaxed);
+  if (tail - buffer->head.load(memory_order_acquire) >= LOGGER_RING_RECORDS) {
+    buffer->dropped.fetch_add(1, memory_order_relaxed);
+    return NULL;
+  }
+  LogRecord* record = &buffer->records[tail % LOGGER_RING_RECORDS];
+  record->time = getSteadyTime();
+  record->format = format;
+  record->file = file;
+  record->func = func;
+  record->line = line;
+  record->level = (uint8_t) level;
+  record->argCount = 0;
+  record->stringsUsed = 0;
+  return record;
+}
+
+/**
+ * Publishes the record taken by the last logBegin on this thread.
+ */
+void logCommit(void)
+{
+  LogThreadBuffer* buffer = localBuffer;
+  buffer->tail.store(buffer->tail.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+/**
+ * Copies a string argument into the record, truncated to the space left.
+ */
+void logCaptureString(LogRecord* record, const char* value)
+{
+  if (value == NULL) {
+    value = "(null)";
+  }
+  size_t room = LOGGER_STRING_BYTES - record->stringsUsed;
+  size_t length = strlen(value);
+  if (room == 0) {
+    record->argTypes[record->argCount] = LOG_ARG_POINTER;
+    record->args[record->argCount++].p = NULL;
+    return;
+  }
+  if (length >= room) {
+    length = room - 1;
+  }
+  memcpy(record->strings + record->stringsUsed, value, length);
+  record->strings[record->stringsUsed + length] = '\0';
+  record->argTypes[record->argCount] = LOG_ARG_STRING;
+  record->args[record->argCount++].s = record->stringsUsed;
+  record->stringsUsed += (uint16_t) (length + 1);
+}
+
+/**
+ * Formats one conversion of a record. spec holds the flags, width and precision taken from the
+ * format, without length modifiers; conversion is the conversion character.
+ */
+static void formatArg(string* out, const LogRecord& record, int arg, const string& spec, char conversion)
+{
+  char field[256];
+  string full = "%" + spec;
+  int n = 0;
+  uint8_t type = record.argTypes[arg];
+  switch (conversion)
+  {
+    case 'd':
+    case 'i':
+    case 'c':
+      full += (conversion == 'c') ? "c" : "lld";
+      if (type == LOG_ARG_DOUBLE) {
+        n = snprintf(field, sizeof(field), full.c_str(), (long long) record.args[arg].d);
+      }
+      else if (conversion == 'c') {
+        n = snprintf(field, sizeof(field), full.c_str(), (int) record.args[arg].i);
+      }
+      else {
+        n = snprintf(field, sizeof(field), full.c_str(), (long long) record.args[arg].i);
+      }
+      break;
+
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+      full += "ll";
+      full += conversion;
+      n = snprintf(field, sizeof(field), full.c_str(), (unsigned long long) record.args[arg].u);
+      break;
+
+    case 's':
+      full += "s";
+      if (type == LOG_ARG_STRING) {
+        n = snprintf(field, sizeof(field), full.c_str(), record.strings + record.args[arg].s);
+      }
+      else {
+        n = snprintf(field, sizeof(field), full.c_str(), "?");
+      }
+      break;
+
+    case 'p':
+      full += "p";
+      n = snprintf(field, sizeof(field), full.c_str(), record.args[arg].p);
+      break;
+
+    default: // floating point conversions
+      full += conversion;
+      if (type == LOG_ARG_INT) {
+        n = snprintf(field, sizeof(field), full.c_str(), (double) record.args[arg].i);
+      }
+      else if (type == LOG_ARG_UINT) {
+        n = snprintf(field, sizeof(field), full.c_str(), (double) record.args[arg].u);
+      }
+      else {
+        n = snprintf(field, sizeof(field), full.c_str(), record.args[arg].d);
+      }
+      break;
+  }
+  if (n > 0) {
+    out->append(field, min(n, (int) sizeof(field) - 1));
+  }
+}
+
+/**
+ * Appends one formatted line for the record.
+ */
+static void formatRecord(string* out, const LogRecord& record, int threadNum)
+{
+  char prefix[64];
+  int n = snprintf(prefix, sizeof(prefix), "[%s %.6f T%d] ", LOG_LEVEL_NAMES[record.level], record.time, threadNum);
+  out->append(prefix, n);
+  out->append(record.file);
+  n = snprintf(prefix, sizeof(prefix), ":%d in ", record.line);
+  out->append(prefix, n);
+  out->append(record.func);
+  out->append(": ");
+
+  const char* f = record.format;
+  int arg = 0;
+  while (*f != '\0') {
+    if (*f != '%') {
+      out->push_back(*f++);
+      continue;
+    }
+    f++;
+    if (*f == '%') {
+      out->push_back(*f++);
+      continue;
+    }
+    string spec;
+    while (*f != '\0' && strchr("-+ #0123456789.", *f) != NULL) {
+      spec.push_back(*f++);
+    }
+    while (*f != '\0' && strchr("hljztL", *f) != NULL) {
+      f++;
+    }
+    if (*f == '\0') {
+      break;
+    }
+    char conversion = *f++;
+    if (arg < record.argCount) {
+      formatArg(out, record, arg++, spec, conversion);
+    }
+    else {
+      out->append("%" + spec);
+      out->push_back(conversion);
+    }
+  }
+  out->push_back('\n');
+}
+
+struct PendingRecord
+{
+  LogRecord record;
+  int threadNum;
+};
+
+static bool pendingBefore(const PendingRecord& a, const PendingRecord& b)
+{
+  return a.record.time < b.record.time;
+}
+
+/**
+ * Drains every thread's ring and writes the records to stdout in time order. May be called from
+ * any thread; the flusher thread calls it periodically.
+ */
+void flushLogger(void)
+{
+  lock_guard<mutex> lock(flushLock);
+  claimFlag(&flushing);
+  vector<LogThreadBuffer*> buffers;
+  {
+    lock_guard<mutex> listLock(bufferListLock);
+    buffers = threadBuffers;
+  }
+  vector<PendingRecord> pending;
+  string out;
+  for (size_t b = 0; b < buffers.size(); b++) {
+    LogThreadBuffer* buffer = buffers[b];
+    size_t head = buffer->head.load(memory_order_relaxed);
+    size_t tail = buffer->tail.load(memory_order_acquire);
+    for (; head != tail; head++) {
+      PendingRecord entry;
+      entry.record = buffer->records[head % LOGGER_RING_RECORDS];
+      entry.threadNum = buffer->threadNum;
+      pending.push_back(entry);
+    }
+    buffer->head.store(head, memory_order_release);
+    uint64_t dropped = buffer->dropped.load(memory_order_relaxed);
+    if (dropped != buffer->droppedReported) {
+      char line[96];
+      int n = snprintf(line, sizeof(line), "[WARN] %llu log messages dropped on thread T%d\n",
+        (unsigned long long) (dropped - buffer->droppedReported), buffer->threadNum);
+      out.append(line, n);
+      recordsDropped += dropped - buffer->droppedReported;
+      buffer->droppedReported = dropped;
+    }
+  }
+  flushing.store(false, memory_order_release);
+  stable_sort(pending.begin(), pending.end(), pendingBefore);
+  for (size_t i = 0; i < pending.size(); i++) {
+    formatRecord(&out, pending[i].record, pending[i].threadNum);
+  }
+  if (!out.empty()) {
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+  }
+}
+
+/**
+ * Writes the record to stdout without allocating. Flags, widths and precisions in the format are
+ * ignored.
+ */
+static void writeRecordFromSignal(const LogRecord& record, int threadNum)
+{
+  char line[1024];
+  size_t used = 0;
+  int n = snprintf(line, sizeof(line), "[%s %.6f T%d] %s:%d in %s: ", LOG_LEVEL_NAMES[record.level], record.time,
+    threadNum, record.file, record.line, record.func);
+  used = (n > 0) ? min((size_t) n, sizeof(line) - 1) : 0;
+  const char* f = record.format;
+  int arg = 0;
+  while (*f != '\0' && used < sizeof(line) - 2) {
+    if (*f != '%' || f[1] == '%') {
+      line[used++] = *f;
+      f += (*f == '%') ? 2 : 1;
+      continue;
+    }
+    f++;
+    while (*f != '\0' && strchr("-+ #0123456789.hljztL", *f) != NULL) {
+      f++;
+    }
+    if (*f == '\0') {
+      break;
+    }
+    f++;
+    if (arg >= record.argCount) {
+      continue;
+    }
+    size_t room = sizeof(line) - 1 - used;
+    switch (record.argTypes[arg])
+    {
+      case LOG_ARG_INT: n = snprintf(line + used, room, "%lld", (long long) record.args[arg].i); break;
+      case LOG_ARG_UINT: n = snprintf(line + used, room, "%llu", (unsigned long long) record.args[arg].u); break;
+      case LOG_ARG_DOUBLE: n = snprintf(line + used, room, "%g", record.args[arg].d); break;
+      case LOG_ARG_STRING: n = snprintf(line + used, room, "%s", record.strings + record.args[arg].s); break;
+      default: n = snprintf(line + used, room, "%p", record.args[arg].p); break;
+    }
+    used += (n > 0) ? min((size_t) n, room - 1) : 0;
+    arg++;
+  }
+  line[used++] = '\n';
+  fwrite(line, 1, used, stdout);
+}
+
+/**
+ * Version of flushLogger for a fatal signal handler. It never blocks: if a flush or a ring
+ * registration is under way on any thread, including the one that faulted, nothing is written
+ * and the records are left to the flight recorder. Otherwise each ring is written out in turn,
+ * unsorted and without allocating.
+ */
+void flushLoggerFromSignal(void)
+{
+  if (flushing.exchange(true, memory_order_acquire)) {
+    return;
+  }
+  if (registering.exchange(true, memory_order_acquire)) {
+    flushing.store(false, memory_order_release);
+    return;
+  }
+  for (size_t b = 0; b < threadBuffers.size(); b++) {
+    LogThreadBuffer* buffer = threadBuffers[b];
+    size_t head = buffer->head.load(memory_order_relaxed);
+    size_t tail = buffer->tail.load(memory_order_acquire);
+    for (; head != tail; head++) {
+      writeRecordFromSignal(buffer->records[head % LOGGER_RING_RECORDS], buffer->threadNum);
+    }
+    buffer->head.store(head, memory_order_release);
+  }
+  fflush(stdout);
+  registering.store(false, memory_order_release);
+  flushing.store(false, memory_order_release);
+}
+
+/**
+ * Starts the flusher thread. Messages logged before this are kept in their rings until the first
+ * flush.
+ */
+void startLogger(void)
+{
+  loggerRunning = true;
+  loggerThread = new cThread();
+  loggerThread->start(updateLogger, CTHREAD_PRIORITY_GRAPHICS);
+}
+
+/**
+ * Flusher thread. Runs until stopLogger is called.
+ */
+void updateLogger(void)
+{
+  double next = getSteadyTime();
+  while (loggerRunning.load()) {
+    flushLogger();
+    next += LOGGER_FLUSH_INTERVAL;
+    sleepCoarselyUntil(next);
+  }
+}
+
+/**
+ * Stops the flusher thread and writes out everything logged so far. Later messages are written by
+ * explicit calls to flushLogger.
+ */
+void stopLogger(void)
+{
+  loggerRunning = false;
+  flushLogger();
+}
+
+/**
+ * @param level Lowest LOG_LEVEL_* that is recorded
+ */
+void setLogLevel(int level)
+{
+  logLevel.store(level);
+}
+
+int getLogLevel(void)
+{
+  return logLevel.load();
+}
+
+/**
+ * @param name Level name, such as "debug" or "warn"
+ * @param level Set to the matching LOG_LEVEL_*
+ *
+ * Returns false if the name is not a level.
+ */
+bool parseLogLevel(const char* name, int* level)
+{
+  static const char* names[] = {"trace", "debug", "info", "warn", "error", "off"};
+  for (int i = 0; i <= LOG_LEVEL_OFF; i++) {
+    if (strcmp(name, names[i]) == 0) {
+      *level = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Returns the number of messages dropped so far because a thread's ring was full.
+ */
+uint64_t getLogRecordsDropped(void)
+{
+  return recordsDropped.load();
+}
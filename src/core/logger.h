@@ -0,0 +1,143 @@
+#pragma once
+
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF 5
+
+// Messages below this level are removed at compile time. Build with -DLOG_LEVEL_FLOOR=LOG_LEVEL_INFO
+// or higher to take debug logging out of a release build entirely.
+#ifndef LOG_LEVEL_FLOOR
+    #define LOG_LEVEL_FLOOR LOG_LEVEL_TRACE
+#endif
+
+#define LOGGER_RING_RECORDS 1024 // records per thread waiting for the flusher
+#define LOGGER_MAX_ARGS 8
+#define LOGGER_STRING_BYTES 128 // bytes per record for copies of string arguments
+#define LOGGER_FLUSH_INTERVAL 0.01 // seconds between flushes
+
+#define LOG_ARG_INT 0
+#define LOG_ARG_UINT 1
+#define LOG_ARG_DOUBLE 2
+#define LOG_ARG_STRING 3
+#define LOG_ARG_POINTER 4
+
+/**
+ * One log call, captured without formatting. format, file and func must be string literals; string
+ * arguments are copied into strings.
+ */
+struct LogRecord
+{
+  double time; // getSteadyTime
+  const char* format;
+  const char* file;
+  const char* func;
+  int line;
+  uint8_t level;
+  uint8_t argCount;
+  uint8_t argTypes[LOGGER_MAX_ARGS]; // LOG_ARG_*
+  uint16_t stringsUsed;
+  union {
+    int64_t i;
+    uint64_t u;
+    double d;
+    const void* p;
+    uint32_t s; // offset into strings
+  } args[LOGGER_MAX_ARGS];
+  char strings[LOGGER_STRING_BYTES];
+};
+
+void startLogger(void);
+void updateLogger(void);
+void stopLogger(void);
+void flushLogger(void);
+void flushLoggerFromSignal(void);
+void setLogLevel(int level);
+int getLogLevel(void);
+bool parseLogLevel(const char* name, int* level);
+uint64_t getLogRecordsDropped(void);
+
+LogRecord* logBegin(int level, const char* file, int line, const char* func, const char* format);
+void logCommit(void);
+void logCaptureString(LogRecord* record, const char* value);
+
+inline void logCapture(LogRecord* record, long long value)
+{
+  record->argTypes[record->argCount] = LOG_ARG_INT;
+  record->args[record->argCount++].i = value;
+}
+
+inline void logCapture(LogRecord* record, unsigned long long value)
+{
+  record->argTypes[record->argCount] = LOG_ARG_UINT;
+  record->args[record->argCount++].u = value;
+}
+
+inline void logCapture(LogRecord* record, double value)
+{
+  record->argTypes[record->argCount] = LOG_ARG_DOUBLE;
+  record->args[record->argCount++].d = value;
+}
+
+inline void logCapture(LogRecord* record, int value) { logCapture(record, (long long) value); }
+inline void logCapture(LogRecord* record, long value) { logCapture(record, (long long) value); }
+inline void logCapture(LogRecord* record, short value) { logCapture(record, (long long) value); }
+inline void logCapture(LogRecord* record, char value) { logCapture(record, (long long) value); }
+inline void logCapture(LogRecord* record, bool value) { logCapture(record, (long long) value); }
+inline void logCapture(LogRecord* record, unsigned int value) { logCapture(record, (unsigned long long) value); }
+inline void logCapture(LogRecord* record, unsigned long value) { logCapture(record, (unsigned long long) value); }
+inline void logCapture(LogRecord* record, unsigned short value) { logCapture(record, (unsigned long long) value); }
+inline void logCapture(LogRecord* record, unsigned char value) { logCapture(record, (unsigned long long) value); }
+inline void logCapture(LogRecord* record, float value) { logCapture(record, (double) value); }
+inline void logCapture(LogRecord* record, const char* value) { logCaptureString(record, value); }
+inline void logCapture(LogRecord* record, char* value) { logCaptureString(record, value); }
+inline void logCapture(LogRecord* record, const std::string& value) { logCaptureString(record, value.c_str()); }
+
+template <typename T>
+inline void logCapture(LogRecord* record, T* value)
+{
+  record->argTypes[record->argCount] = LOG_ARG_POINTER;
+  record->args[record->argCount++].p = (const void*) value;
+}
+
+/**
+ * Captures a log call into the calling thread's buffer. Formatting happens later on the flusher
+ * thread, so the caller only pays for copying the arguments.
+ */
+template <typename... Args>
+inline void logWrite(int level, const char* file, int line, const char* func, const char* format, const Args&... args)
+{
+  static_assert(sizeof...(Args) <= LOGGER_MAX_ARGS, "Too many arguments for one log call");
+  LogRecord* record = logBegin(level, file, line, func, format);
+  if (record == NULL) {
+    return;
+  }
+  int captured[] = {0, (logCapture(record, args), 0)...};
+  (void) captured;
+  logCommit();
+}
+
+// printf-style logging. The format must be a string literal.
+#define LOG_AT(level, ...) \
+  do { \
+    if ((level) >= LOG_LEVEL_FLOOR) { \
+      logWrite((level), __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__); \
+    } \
+  } while (0)
+
+#define LOG_TRACE(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif
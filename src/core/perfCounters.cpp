@@ -0,0 +1,215 @@
+#include "perfCounters.h"
+
+#include "core/debug.h"
+#include <atomic>
+#include <string.h>
+
+#ifdef __linux__
+    #include <errno.h>
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+/**
+ * @file perfCounters.h
+ * @file perfCounters.cpp
+ * @brief Hardware performance counters for the phases of the haptic tick
+ *
+ * With --perf-counters on Linux, the haptic thread opens a perf_event_open group that counts its
+ * own cycles, instructions, last-level cache misses and context switches. perfTickStart reads the
+ * group at the start of a tick and perfPhaseEnd reads it again after each phase. The difference is
+ * added to that phase's totals. Each read is one system call returning the whole group, so a tick
+ * costs PERF_PHASE_COUNT + 1 reads, a few microseconds in all. The statistics thread turns the
+ * totals into per second figures, see stats.h.
+ *
+ * Counters the kernel or hardware does not provide are left out; virtual machines often have no
+ * hardware counters at all. Kernel time is counted where perf_event_paranoid allows it, so the
+ * cost of device I/O shows up in its phase, and user time only otherwise. Elsewhere, and without
+ * the option, every call returns at once.
+ */
+
+static const char* PERF_PHASE_NAMES[] = {"positions", "deviceRead", "forces", "deviceWrite", "publish"};
+static const char* PERF_COUNTER_NAMES[] = {"cycles", "instructions", "llcMisses", "contextSwitches"};
+
+static bool perfOpen = false; // haptic thread only, apart from getPerfTotals
+static int groupFd = -1;
+static int counterFds[PERF_COUNTER_COUNT];
+static int counterSlot[PERF_COUNTER_COUNT]; // position of each counter in a group read, -1 if not open
+static int slotsOpen = 0;
+static uint64_t lastValues[PERF_COUNTER_COUNT + 1];
+static atomic<uint32_t> available(0);
+static atomic<uint64_t> ticks(0);
+static atomic<uint64_t> counts[PERF_PHASE_COUNT][PERF_COUNTER_COUNT];
+
+#ifdef __linux__
+
+static int openCounter(uint32_t type, uint64_t config, int leader)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = (leader == -1) ? 1 : 0;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  int fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+  if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+    attr.exclude_kernel = 1;
+    fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+  }
+  return fd;
+}
+
+/**
+ * Reads every counter in the group into values, in group order.
+ */
+static bool readGroup(uint64_t* values)
+{
+  uint64_t buffer[PERF_COUNTER_COUNT + 1];
+  ssize_t length = read(groupFd, buffer, sizeof(buffer));
+  if (length < (ssize_t) sizeof(uint64_t) || buffer[0] != (uint64_t) slotsOpen) {
+    return false;
+  }
+  memcpy(values, buffer + 1, slotsOpen*sizeof(uint64_t));
+  return true;
+}
+
+#endif
+
+/**
+ * Opens the counters for the calling thread, which must be the haptic thread. Returns false if
+ * none could be opened or the platform has no perf_event_open.
+ */
+bool openPerfCounters(void)
+{
+#ifdef __linux__
+  static const uint32_t types[PERF_COUNTER_COUNT] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE
+  };
+  static const uint64_t configs[PERF_COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_SW_CONTEXT_SWITCHES
+  };
+  uint32_t opened = 0;
+  slotsOpen = 0;
+  groupFd = -1;
+  for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+    counterFds[c] = openCounter(types[c], configs[c], groupFd);
+    counterSlot[c] = -1;
+    if (counterFds[c] < 0) {
+      LOG_WARN("Performance counter %s is not available (errno %d)", PERF_COUNTER_NAMES[c], errno);
+      continue;
+    }
+    if (groupFd == -1) {
+      groupFd = counterFds[c];
+    }
+    counterSlot[c] = slotsOpen++;
+    opened |= 1u << c;
+  }
+  if (groupFd == -1) {
+    LOG_WARN("No performance counters could be opened");
+    return false;
+  }
+  ioctl(groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  available.store(opened);
+  perfOpen = true;
+  LOG_INFO("Performance counters opened on the haptic thread (mask 0x%x)", opened);
+  return true;
+#else
+  LOG_WARN("Performance counters are only available on Linux");
+  return false;
+#endif
+}
+
+/**
+ * Stops counting and closes the counters. Totals are kept.
+ */
+void closePerfCounters(void)
+{
+#ifdef __linux__
+  if (!perfOpen) {
+    return;
+  }
+  perfOpen = false;
+  ioctl(groupFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  for (int c = PERF_COUNTER_COUNT - 1; c >= 0; c--) {
+    if (counterFds[c] >= 0) {
+      close(counterFds[c]);
+    }
+  }
+  groupFd = -1;
+#endif
+}
+
+/**
+ * Called by the haptic thread at the start of each tick.
+ */
+void perfTickStart(void)
+{
+#ifdef __linux__
+  if (!perfOpen) {
+    return;
+  }
+  if (readGroup(lastValues)) {
+    ticks.store(ticks.load(memory_order_relaxed) + 1, memory_order_relaxed);
+  }
+#endif
+}
+
+/**
+ * @param phase PERF_PHASE_* that has just finished
+ *
+ * Adds the counts since the start of the tick or the end of the previous phase to phase.
+ */
+void perfPhaseEnd(int phase)
+{
+#ifdef __linux__
+  if (!perfOpen) {
+    return;
+  }
+  uint64_t values[PERF_COUNTER_COUNT + 1];
+  if (!readGroup(values)) {
+    return;
+  }
+  for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+    int slot = counterSlot[c];
+    if (slot >= 0) {
+      atomic<uint64_t>& total = counts[phase][c];
+      total.store(total.load(memory_order_relaxed) + (values[slot] - lastValues[slot]), memory_order_relaxed);
+      lastValues[slot] = values[slot];
+    }
+  }
+#else
+  (void) phase;
+#endif
+}
+
+/**
+ * Copies the totals. May be called from any thread.
+ */
+void getPerfTotals(PerfTotals* totals)
+{
+  totals->available = available.load();
+  totals->ticks = ticks.load(memory_order_relaxed);
+  for (int p = 0; p < PERF_PHASE_COUNT; p++) {
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+      totals->counts[p][c] = counts[p][c].load(memory_order_relaxed);
+    }
+  }
+}
+
+const char* getPerfPhaseName(int phase)
+{
+  return PERF_PHASE_NAMES[phase];
+}
+
+const char* getPerfCounterName(int counter)
+{
+  return PERF_COUNTER_NAMES[counter];
+}
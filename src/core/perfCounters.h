@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef _PERFCOUNTERS_H_
+#define _PERFCOUNTERS_H_
+
+#include <stdint.h>
+
+// Phases of updateHaptics that counts are attributed to
+#define PERF_PHASE_POSITIONS 0 // computeGlobalPositions
+#define PERF_PHASE_DEVICE_READ 1 // updateFromDevice
+#define PERF_PHASE_FORCES 2 // computeInteractionForces
+#define PERF_PHASE_DEVICE_WRITE 3 // applyToDevice
+#define PERF_PHASE_PUBLISH 4 // sample history and recording tap
+#define PERF_PHASE_COUNT 5
+
+#define PERF_COUNTER_CYCLES 0
+#define PERF_COUNTER_INSTRUCTIONS 1
+#define PERF_COUNTER_LLC_MISSES 2
+#define PERF_COUNTER_CONTEXT_SWITCHES 3
+#define PERF_COUNTER_COUNT 4
+
+/**
+ * Counter totals since the counters were opened, by phase and PERF_COUNTER_*.
+ */
+struct PerfTotals
+{
+  uint32_t available; // bit (1 << PERF_COUNTER_*) for each counter that could be opened
+  uint64_t ticks;
+  uint64_t counts[PERF_PHASE_COUNT][PERF_COUNTER_COUNT];
+};
+
+bool openPerfCounters(void);
+void closePerfCounters(void);
+void perfTickStart(void);
+void perfPhaseEnd(int phase);
+void getPerfTotals(PerfTotals* totals);
+const char* getPerfPhaseName(int phase);
+const char* getPerfCounterName(int counter);
+
+#endif
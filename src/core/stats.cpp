@@ -0,0 +1,693 @@
+#include "stats.h"
+
+#include "core/controller.h"
+#include "core/debug.h"
+#include "core/perfCounters.h"
+#include "core/timing.h"
+#include "platform_compat.h"
+#include "rpc/server.h"
+#include <math.h>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+using namespace chai3d;
+using namespace std;
+
+/**
+ * @file stats.h
+ * @file stats.cpp
+ * @brief Runtime statistics, readable over RPC and from a shared memory page
+ *
+ * The haptic, graphics and listener threads feed durations into LatencyHistograms as they run. A
+ * statistics thread wakes up every STATS_PAGE_INTERVAL, summarizes the histograms, reads the
+ * counters kept by the listener, publisher, streamer and recorder, and works out rates from the
+ * change since its last pass. The result is written to the shared memory page described in
+ * statsPage.h and kept for getStats.
+ *
+ * For every message type, latencies are measured from the header timestamp to receipt, to the end
+ * of parsing, and to the first haptic tick and the first frame that began after parsing ended, when
+ * the change is live. The listener queues each parsed message in a small ring. The haptic and
+ * graphics threads note how far the ring had been filled when their tick or frame began, and once
+ * it is done they record the latency of each message up to that point. A loop with nothing new to
+ * match only compares two counters.
+ *
+ * getStats and resetStats are also served by a small rpc::server of our own, so Trial Control or a
+ * dashboard can query a running environment the same way it talks to MessageHandler:
+ *
+ *     rpc::client stats("127.0.0.1", STATS_RPC_PORT_DEFAULT);
+ *     auto values = stats.call("getStats").as<std::map<std::string, double>>();
+ */
+
+static_assert(STATS_PERF_PHASES == PERF_PHASE_COUNT && STATS_PERF_COUNTERS == PERF_COUNTER_COUNT,
+  "statsPage.h and perfCounters.h disagree on the performance counter layout");
+
+extern HapticData hapticsData;
+extern GraphicsData graphicsData;
+
+/**
+ * Histograms kept for each message type.
+ */
+struct MessageStats
+{
+  atomic<int> msgType{0};
+  atomic<uint64_t> received{0};
+  LatencyHistogram parseTime;
+  LatencyHistogram receiveLatency;
+  LatencyHistogram parseLatency;
+  LatencyHistogram tickLatency;
+  LatencyHistogram frameLatency;
+};
+
+/**
+ * A parsed message waiting to be matched to the tick and the frame that apply it.
+ */
+struct PendingApply
+{
+  MessageStats* stats;
+  double sentTime; // header timestamp
+};
+
+static LatencyHistogram hapticPeriod;
+static LatencyHistogram hapticJitter;
+static LatencyHistogram framePeriod;
+static LatencyHistogram swapLatency;
+static LatencyHistogram predictionError; // distances, stored as if they were seconds
+static atomic<double> predictionHorizon(0.0);
+static MessageStats messageStats[STATS_MSG_TYPES];
+static atomic<int> messageTypesUsed(0);
+static mutex messageTypesLock; // taken only to add a message type
+
+static PendingApply applyRing[STATS_APPLY_RING]; // written by the listener only
+static atomic<uint64_t> appliesPosted(0);
+
+static double lastTickTime = -1.0; // haptic thread only
+static double lastTickPeriod = -1.0;
+static uint64_t tickApplied = 0;
+static uint64_t tickApplyLimit = 0;
+static double lastFrameTime = -1.0; // graphics thread only
+static uint64_t frameApplied = 0;
+static uint64_t frameApplyLimit = 0;
+
+static atomic<bool> statsRunning(false);
+static cThread* statsThread = NULL;
+static StatsPage* statsPage = NULL;
+static mutex pageLock; // guards statsPage against being unmapped while it is written
+static rpc::server* statsServer = NULL;
+static mutex latestLock; // guards latest
+static StatsPageData latest;
+static PerfTotals perfWindowStart; // statistics thread only
+static double perfWindowTime = 0.0;
+
+static inline int leadingZeros(uint64_t x)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, x);
+  return 63 - (int) index;
+#else
+  return __builtin_clzll(x);
+#endif
+}
+
+static inline int bucketIndex(uint64_t ns)
+{
+  if (ns < (2ULL << STATS_HISTOGRAM_SUB_BITS)) {
+    return (int) ns;
+  }
+  int msb = 63 - leadingZeros(ns);
+  if (msb > STATS_HISTOGRAM_MAX_BITS) {
+    return STATS_HISTOGRAM_BUCKETS - 1;
+  }
+  int shift = msb - STATS_HISTOGRAM_SUB_BITS;
+  return (shift << STATS_HISTOGRAM_SUB_BITS) + (int) (ns >> shift);
+}
+
+/**
+ * Returns the middle of the range of values that fall into a bucket, in nanoseconds.
+ */
+static inline double bucketValue(int bucket)
+{
+  if (bucket < (2 << STATS_HISTOGRAM_SUB_BITS)) {
+    return (double) bucket;
+  }
+  int shift = (bucket >> STATS_HISTOGRAM_SUB_BITS) - 1;
+  uint64_t lower = (uint64_t) (bucket - (shift << STATS_HISTOGRAM_SUB_BITS)) << shift;
+  return (double) lower + (double) (1ULL << shift)/2.0;
+}
+
+/**
+ * @param seconds Duration to add. Negative durations are counted as zero.
+ */
+void LatencyHistogram::record(double seconds)
+{
+  uint64_t ns = (seconds > 0.0) ? (uint64_t) (seconds*1e9 + 0.5) : 0;
+  counts[bucketIndex(ns)].fetch_add(1, memory_order_relaxed);
+  total.fetch_add(1, memory_order_relaxed);
+  sumNs.fetch_add(ns, memory_order_relaxed);
+  uint64_t currentMax = maxNs.load(memory_order_relaxed);
+  while (ns > currentMax && !maxNs.compare_exchange_weak(currentMax, ns, memory_order_relaxed)) {
+  }
+}
+
+/**
+ * Empties the histogram. Values recorded by another thread while this runs may be kept or lost.
+ */
+void LatencyHistogram::reset(void)
+{
+  for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+    counts[i].store(0, memory_order_relaxed);
+  }
+  total.store(0, memory_order_relaxed);
+  sumNs.store(0, memory_order_relaxed);
+  maxNs.store(0, memory_order_relaxed);
+}
+
+/**
+ * Fills summary with the count, mean, percentiles and maximum, in seconds.
+ */
+void LatencyHistogram::summarize(StatsSummary* summary) const
+{
+  static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  double* targets[] = {&summary->p50, &summary->p90, &summary->p99, &summary->p999};
+  uint64_t copy[STATS_HISTOGRAM_BUCKETS];
+  uint64_t count = 0;
+  for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+    copy[i] = counts[i].load(memory_order_relaxed);
+    count += copy[i];
+  }
+  double max = maxNs.load(memory_order_relaxed);
+  summary->count = count;
+  summary->mean = (count > 0) ? sumNs.load(memory_order_relaxed)/(double) count*1e-9 : 0.0;
+  summary->max = max*1e-9;
+  uint64_t seen = 0;
+  int bucket = 0;
+  for (int q = 0; q < 4; q++) {
+    uint64_t rank = (uint64_t) (quantiles[q]*count + 0.5);
+    if (rank == 0) {
+      rank = 1;
+    }
+    while (bucket < STATS_HISTOGRAM_BUCKETS && seen + copy[bucket] < rank) {
+      seen += copy[bucket++];
+    }
+    double value = (count > 0 && bucket < STATS_HISTOGRAM_BUCKETS) ? bucketValue(bucket) : 0.0;
+    *targets[q] = ((value < max) ? value : max)*1e-9;
+  }
+}
+
+/**
+ * Returns the statistics of a message type, adding it the first time it is seen. Returns NULL if
+ * STATS_MSG_TYPES types are already tracked.
+ */
+static MessageStats* getMessageStats(int msgType)
+{
+  int used = messageTypesUsed.load(memory_order_acquire);
+  for (int i = 0; i < used; i++) {
+    if (messageStats[i].msgType.load(memory_order_relaxed) == msgType) {
+      return &messageStats[i];
+    }
+  }
+  lock_guard<mutex> lock(messageTypesLock);
+  used = messageTypesUsed.load(memory_order_relaxed);
+  for (int i = 0; i < used; i++) {
+    if (messageStats[i].msgType.load(memory_order_relaxed) == msgType) {
+      return &messageStats[i];
+    }
+  }
+  if (used == STATS_MSG_TYPES) {
+    return NULL;
+  }
+  messageStats[used].msgType.store(msgType, memory_order_relaxed);
+  messageTypesUsed.store(used + 1, memory_order_release);
+  return &messageStats[used];
+}
+
+/**
+ * Records the latency of the parsed messages from *applied up to limit, which took effect by time.
+ * Messages that were overwritten in the ring before the caller got to them, or are being
+ * overwritten, are skipped.
+ */
+static void recordApplied(uint64_t* applied, uint64_t limit, double time, LatencyHistogram MessageStats::* latency)
+{
+  if (limit - *applied > STATS_APPLY_RING) {
+    *applied = limit - STATS_APPLY_RING;
+  }
+  double now = toMessageHandlerTime(time);
+  for (; *applied < limit; (*applied)++) {
+    PendingApply entry = applyRing[*applied & (STATS_APPLY_RING - 1)];
+    if (appliesPosted.load(memory_order_acquire) - *applied >= STATS_APPLY_RING) {
+      continue;
+    }
+    (entry.stats->*latency).record(now - entry.sentTime);
+  }
+}
+
+/**
+ * Called from the haptic thread at the start of each tick. Messages parsed before this point are
+ * live in the tick.
+ */
+void statsHapticTickStart(void)
+{
+  tickApplyLimit = appliesPosted.load(memory_order_acquire);
+}
+
+/**
+ * @param tickTime getSteadyTime of the tick
+ *
+ * Called once per tick from the haptic thread.
+ */
+void statsHapticTick(double tickTime)
+{
+  if (tickApplied != tickApplyLimit) {
+    recordApplied(&tickApplied, tickApplyLimit, tickTime, &MessageStats::tickLatency);
+  }
+  if (lastTickTime >= 0.0) {
+    double period = tickTime - lastTickTime;
+    hapticPeriod.record(period);
+    if (lastTickPeriod >= 0.0) {
+      hapticJitter.record(fabs(period - lastTickPeriod));
+    }
+    lastTickPeriod = period;
+  }
+  lastTickTime = tickTime;
+}
+
+/**
+ * Called from the graphics thread before each frame is rendered.
+ */
+void statsFrameStart(void)
+{
+  frameApplyLimit = appliesPosted.load(memory_order_acquire);
+}
+
+/**
+ * @param frameTime getSteadyTime at which the frame was swapped to the screen
+ *
+ * Called once per frame from the graphics thread.
+ */
+void statsFrame(double frameTime)
+{
+  if (frameApplied != frameApplyLimit) {
+    recordApplied(&frameApplied, frameApplyLimit, frameTime, &MessageStats::frameLatency);
+  }
+  if (lastFrameTime >= 0.0) {
+    framePeriod.record(frameTime - lastFrameTime);
+  }
+  lastFrameTime = frameTime;
+}
+
+/**
+ * @param sampleTime getSteadyTime of the device read in the haptic tick that a frame rendered
+ * @param swapTime getSteadyTime at which the frame's buffer swap completed
+ *
+ * Called from the graphics thread once the swap time of a frame is known, which may be a frame or
+ * two after it was drawn.
+ */
+void statsFrameSwap(double sampleTime, double swapTime)
+{
+  swapLatency.record(swapTime - sampleTime);
+}
+
+/**
+ * @param horizon Time ahead of the tool state that the cursor was predicted for
+ * @param error Distance between the predicted position and the true one at that time
+ *
+ * Called from the graphics thread once the true position for a prediction is known.
+ */
+void statsPrediction(double horizon, double error)
+{
+  predictionError.record(error);
+  predictionHorizon.store(horizon, memory_order_relaxed);
+}
+
+/**
+ * @param header Header of the packet
+ * @param receiveTime getSteadyTime at which the listener read it
+ *
+ * Called from the listener for every packet. Packets without a timestamp are counted but their
+ * latencies are not recorded.
+ */
+void statsMessageReceived(const MSG_HEADER& header, double receiveTime)
+{
+  MessageStats* stats = getMessageStats(header.msg_type);
+  if (stats == NULL) {
+    return;
+  }
+  stats->received.fetch_add(1, memory_order_relaxed);
+  if (header.timestamp > 0.0) {
+    stats->receiveLatency.record(toMessageHandlerTime(receiveTime) - header.timestamp);
+  }
+}
+
+/**
+ * @param header Header of the packet
+ * @param parseStart getSteadyTime at which parsePacket started on it
+ * @param parseEnd getSteadyTime at which parsePacket was done with it
+ *
+ * Called from the listener once parsePacket has applied a message. The message is queued to be
+ * matched to the next haptic tick and frame.
+ */
+void statsMessageParsed(const MSG_HEADER& header, double parseStart, double parseEnd)
+{
+  MessageStats* stats = getMessageStats(header.msg_type);
+  if (stats == NULL) {
+    return;
+  }
+  stats->parseTime.record(parseEnd - parseStart);
+  if (header.timestamp > 0.0) {
+    stats->parseLatency.record(toMessageHandlerTime(parseEnd) - header.timestamp);
+    uint64_t posted = appliesPosted.load(memory_order_relaxed);
+    PendingApply& entry = applyRing[posted & (STATS_APPLY_RING - 1)];
+    entry.stats = stats;
+    entry.sentTime = header.timestamp;
+    appliesPosted.store(posted + 1, memory_order_release);
+  }
+}
+
+/**
+ * Empties the histograms of every message type. Called at SESSION_START, so that each session's
+ * latencies can be audited on their own.
+ */
+void resetMessageLatencies(void)
+{
+  int used = messageTypesUsed.load(memory_order_acquire);
+  for (int i = 0; i < used; i++) {
+    MessageStats& stats = messageStats[i];
+    stats.received.store(0, memory_order_relaxed);
+    stats.parseTime.reset();
+    stats.receiveLatency.reset();
+    stats.parseLatency.reset();
+    stats.tickLatency.reset();
+    stats.frameLatency.reset();
+  }
+}
+
+/**
+ * Empties every histogram. Counters kept by other modules are not affected.
+ */
+void resetStats(void)
+{
+  hapticPeriod.reset();
+  hapticJitter.reset();
+  framePeriod.reset();
+  swapLatency.reset();
+  predictionError.reset();
+  resetMessageLatencies();
+  LOG_INFO("Statistics reset");
+}
+
+/**
+ * Fills in the performance counter section. Rates are only recalculated once every
+ * STATS_PERF_WINDOW; in between, the previous ones are kept.
+ */
+static void collectPerfStats(StatsPageData* data, const StatsPageData& previous)
+{
+  PerfTotals totals;
+  getPerfTotals(&totals);
+  data->perfAvailable = totals.available;
+  data->perfReserved = 0;
+  double elapsed = data->uptime - perfWindowTime;
+  bool newWindow = (elapsed >= STATS_PERF_WINDOW);
+  uint64_t windowTicks = totals.ticks - perfWindowStart.ticks;
+  if (newWindow) {
+    data->perfTickRate = windowTicks/elapsed;
+  }
+  else {
+    data->perfTickRate = previous.perfTickRate;
+  }
+  for (int p = 0; p < PERF_PHASE_COUNT; p++) {
+    StatsPerfPhase& phase = data->perfPhases[p];
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+      phase.totals[c] = totals.counts[p][c];
+      if (newWindow) {
+        uint64_t delta = totals.counts[p][c] - perfWindowStart.counts[p][c];
+        phase.perSecond[c] = delta/elapsed;
+        phase.perTick[c] = (windowTicks > 0) ? delta/(double) windowTicks : 0.0;
+      }
+      else {
+        phase.perSecond[c] = previous.perfPhases[p].perSecond[c];
+        phase.perTick[c] = previous.perfPhases[p].perTick[c];
+      }
+    }
+  }
+  if (newWindow) {
+    perfWindowStart = totals;
+    perfWindowTime = data->uptime;
+  }
+}
+
+/**
+ * Fills data from the histograms and the other modules' counters. Rates are worked out against
+ * previous, the result of the last pass.
+ */
+static void collectStats(StatsPageData* data, const StatsPageData& previous)
+{
+  data->time = getMessageHandlerTime();
+  data->uptime = getSteadyTime();
+  double elapsed = data->uptime - previous.uptime;
+
+  data->hapticRate = hapticsData.freqCounterHaptics.getFrequency();
+  data->graphicsRate = graphicsData.freqCounterGraphics.getFrequency();
+  hapticPeriod.summarize(&data->hapticPeriod);
+  hapticJitter.summarize(&data->hapticJitter);
+  framePeriod.summarize(&data->framePeriod);
+  swapLatency.summarize(&data->swapLatency);
+  predictionError.summarize(&data->predictionError);
+  data->predictionHorizon = predictionHorizon.load(memory_order_relaxed);
+
+  ListenerStats listener = getListenerStats();
+  PublisherStats publisher = getPublisherStats();
+  StreamerStats streamer = getStreamerStats();
+  RecorderStats recorder = getRecorderStats();
+  data->packetsIn = listener.packetsRead;
+  data->packetsLost = listener.totals.lost;
+  data->kernelDrops = listener.kernelDrops;
+  data->packetsOut = publisher.sent;
+  data->packetsOutDropped = publisher.dropped;
+  data->packetsOutFailed = publisher.failed;
+  data->publisherQueueDepth = publisher.queueDepth;
+  data->streamSamples = streamer.samplesSent;
+  data->streamMissedDeadlines = streamer.missedDeadlines;
+  data->recordingBytes = recorder.bytesWritten;
+  data->recordingRows = recorder.recordsWritten;
+  data->recordingRowsDropped = recorder.recordsDropped;
+  data->recorderQueueDepth = recorder.queueDepth;
+  data->recorderHighWaterMark = recorder.highWaterMark;
+  data->logRecordsDropped = getLogRecordsDropped();
+  collectPerfStats(data, previous);
+
+  if (elapsed > 0.0 && previous.uptime > 0.0) {
+    data->packetsInRate = (data->packetsIn - previous.packetsIn)/elapsed;
+    data->packetsOutRate = (data->packetsOut - previous.packetsOut)/elapsed;
+    data->recordingBytesRate = (data->recordingBytes - previous.recordingBytes)/elapsed;
+    data->recordingRowsRate = (data->recordingRows - previous.recordingRows)/elapsed;
+  }
+  else {
+    data->packetsInRate = 0.0;
+    data->packetsOutRate = 0.0;
+    data->recordingBytesRate = 0.0;
+    data->recordingRowsRate = 0.0;
+  }
+
+  int used = messageTypesUsed.load(memory_order_acquire);
+  data->msgTypeCount = (uint32_t) used;
+  data->reserved = 0;
+  for (int i = 0; i < used; i++) {
+    StatsMessageSummary& message = data->messages[i];
+    message.msgType = messageStats[i].msgType.load(memory_order_relaxed);
+    message.reserved = 0;
+    message.received = messageStats[i].received.load(memory_order_relaxed);
+    messageStats[i].parseTime.summarize(&message.parseTime);
+    messageStats[i].receiveLatency.summarize(&message.receiveLatency);
+    messageStats[i].parseLatency.summarize(&message.parseLatency);
+    messageStats[i].tickLatency.summarize(&message.tickLatency);
+    messageStats[i].frameLatency.summarize(&message.frameLatency);
+  }
+}
+
+/**
+ * Copies data into the shared page, marking it as being written while it changes.
+ */
+static void writeStatsPage(const StatsPageData& data)
+{
+  uint64_t sequence = statsPage->sequence.load(memory_order_relaxed);
+  statsPage->sequence.store(sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy(&statsPage->data, &data, sizeof(data));
+  statsPage->sequence.store(sequence + 2, memory_order_release);
+}
+
+/**
+ * @param address Address the statistics RPC server listens on
+ * @param rpcPort Port of the statistics RPC server, or 0 for none
+ *
+ * Creates the shared statistics page, starts the RPC server and starts the statistics thread.
+ * Either of the first two may fail, for example if the port is taken; the failure is logged and
+ * the rest carries on.
+ */
+void startStats(const char* address, int rpcPort)
+{
+  statsPage = (StatsPage*) platform::createSharedMemory(STATS_PAGE_NAME, sizeof(StatsPage));
+  if (statsPage == NULL) {
+    LOG_WARN("Could not create the shared statistics page %s", STATS_PAGE_NAME);
+  }
+  else {
+    statsPage->sequence.store(0, memory_order_relaxed);
+    memset(&statsPage->data, 0, sizeof(statsPage->data));
+    statsPage->version = STATS_PAGE_VERSION;
+    statsPage->magic = STATS_PAGE_MAGIC;
+  }
+
+  if (rpcPort > 0) {
+    try {
+      statsServer = new rpc::server(address, (uint16_t) rpcPort);
+      statsServer->bind("getStats", [](){return getStats();});
+      statsServer->bind("resetStats", [](){resetStats(); return 1;});
+      statsServer->bind("resetLatencies", [](){resetMessageLatencies(); return 1;});
+      statsServer->async_run(1);
+      LOG_INFO("Statistics RPC server listening on %s:%d", address, rpcPort);
+    } catch (const std::exception& e) {
+      LOG_WARN("Could not start the statistics RPC server on port %d: %s", rpcPort, e.what());
+      statsServer = NULL;
+    }
+  }
+
+  statsRunning = true;
+  statsThread = new cThread();
+  statsThread->start(updateStats, CTHREAD_PRIORITY_GRAPHICS);
+}
+
+/**
+ * Statistics thread. Runs until stopStats is called.
+ */
+void updateStats(void)
+{
+  StatsPageData previous;
+  StatsPageData current;
+  memset(&previous, 0, sizeof(previous));
+  memset(&current, 0, sizeof(current));
+  double next = getSteadyTime();
+  while (statsRunning.load()) {
+    collectStats(&current, previous);
+    {
+      lock_guard<mutex> lock(pageLock);
+      if (statsPage != NULL) {
+        writeStatsPage(current);
+      }
+    }
+    {
+      lock_guard<mutex> lock(latestLock);
+      latest = current;
+    }
+    previous = current;
+    next += STATS_PAGE_INTERVAL;
+    sleepCoarselyUntil(next);
+  }
+}
+
+/**
+ * Stops the statistics thread and the RPC server and removes the page's name, so dashboards see
+ * that the environment has gone. Processes that still have the page mapped keep the last values.
+ */
+void stopStats(void)
+{
+  statsRunning = false;
+  if (statsServer != NULL) {
+    statsServer->stop();
+  }
+  lock_guard<mutex> lock(pageLock);
+  if (statsPage != NULL) {
+    platform::closeSharedMemory(statsPage, sizeof(StatsPage), STATS_PAGE_NAME);
+    statsPage = NULL;
+  }
+}
+
+/**
+ * Copies the result of the statistics thread's last pass.
+ */
+void getLatestStats(StatsPageData* data)
+{
+  lock_guard<mutex> lock(latestLock);
+  *data = latest;
+}
+
+static void addSummary(map<string, double>* values, const string& prefix, const StatsSummary& summary)
+{
+  (*values)[prefix + ".count"] = (double) summary.count;
+  (*values)[prefix + ".mean"] = summary.mean;
+  (*values)[prefix + ".p50"] = summary.p50;
+  (*values)[prefix + ".p90"] = summary.p90;
+  (*values)[prefix + ".p99"] = summary.p99;
+  (*values)[prefix + ".p999"] = summary.p999;
+  (*values)[prefix + ".max"] = summary.max;
+}
+
+/**
+ * Returns the last statistics as name/value pairs, the form served by the getStats RPC. Per
+ * message values are named after the msg_type, such as "parse.2050.p99" for the time spent
+ * parsing, or "latency.502.tick.p99" for the latency until the first haptic tick.
+ */
+map<string, double> getStats(void)
+{
+  StatsPageData data;
+  getLatestStats(&data);
+  map<string, double> values;
+  values["time"] = data.time;
+  values["uptime"] = data.uptime;
+  values["haptics.rate"] = data.hapticRate;
+  values["graphics.rate"] = data.graphicsRate;
+  addSummary(&values, "haptics.period", data.hapticPeriod);
+  addSummary(&values, "haptics.jitter", data.hapticJitter);
+  addSummary(&values, "graphics.period", data.framePeriod);
+  addSummary(&values, "graphics.swapLatency", data.swapLatency);
+  if (data.predictionError.count > 0) {
+    addSummary(&values, "graphics.predictionError", data.predictionError);
+    values["graphics.predictionHorizon"] = data.predictionHorizon;
+  }
+  values["packets.in"] = (double) data.packetsIn;
+  values["packets.in.lost"] = (double) data.packetsLost;
+  values["packets.in.kernelDrops"] = (double) data.kernelDrops;
+  values["packets.in.rate"] = data.packetsInRate;
+  values["packets.out"] = (double) data.packetsOut;
+  values["packets.out.dropped"] = (double) data.packetsOutDropped;
+  values["packets.out.failed"] = (double) data.packetsOutFailed;
+  values["packets.out.rate"] = data.packetsOutRate;
+  values["publisher.queueDepth"] = (double) data.publisherQueueDepth;
+  values["streamer.samples"] = (double) data.streamSamples;
+  values["streamer.missedDeadlines"] = (double) data.streamMissedDeadlines;
+  values["recorder.bytes"] = (double) data.recordingBytes;
+  values["recorder.rows"] = (double) data.recordingRows;
+  values["recorder.rowsDropped"] = (double) data.recordingRowsDropped;
+  values["recorder.queueDepth"] = (double) data.recorderQueueDepth;
+  values["recorder.highWaterMark"] = (double) data.recorderHighWaterMark;
+  values["recorder.bytesRate"] = data.recordingBytesRate;
+  values["recorder.rowsRate"] = data.recordingRowsRate;
+  values["logger.dropped"] = (double) data.logRecordsDropped;
+  if (data.perfAvailable != 0) {
+    values["perf.tickRate"] = data.perfTickRate;
+    for (int p = 0; p < PERF_PHASE_COUNT; p++) {
+      string phase = string("perf.") + getPerfPhaseName(p) + ".";
+      for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (data.perfAvailable & (1u << c)) {
+          values[phase + getPerfCounterName(c)] = data.perfPhases[p].perSecond[c];
+          values[phase + getPerfCounterName(c) + "PerTick"] = data.perfPhases[p].perTick[c];
+        }
+      }
+    }
+  }
+  for (uint32_t i = 0; i < data.msgTypeCount; i++) {
+    const StatsMessageSummary& message = data.messages[i];
+    string type = to_string(message.msgType);
+    values["received." + type] = (double) message.received;
+    addSummary(&values, "parse." + type, message.parseTime);
+    addSummary(&values, "latency." + type + ".receive", message.receiveLatency);
+    addSummary(&values, "latency." + type + ".parsed", message.parseLatency);
+    addSummary(&values, "latency." + type + ".tick", message.tickLatency);
+    addSummary(&values, "latency." + type + ".frame", message.frameLatency);
+  }
+  return values;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <atomic>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include "messageDefinitions.h"
+#include "statsPage.h"
+
+#define STATS_RPC_PORT_DEFAULT 8081 // 0 disables the statistics RPC server
+#define STATS_HISTOGRAM_SUB_BITS 5 // 32 buckets per power of two, about 3% resolution
+#define STATS_HISTOGRAM_MAX_BITS 40 // durations up to 2^40 ns (about 18 minutes)
+#define STATS_APPLY_RING 256 // parsed messages waiting for the next haptic tick and frame, power of two
+#define STATS_HISTOGRAM_BUCKETS ((STATS_HISTOGRAM_MAX_BITS - STATS_HISTOGRAM_SUB_BITS + 2) << STATS_HISTOGRAM_SUB_BITS)
+
+/**
+ * Log-linear histogram of durations, in the style of HdrHistogram. Values are kept in nanoseconds.
+ * Below 2^(SUB_BITS+1) ns every value has its own bucket; above that each power of two is split
+ * into 2^SUB_BITS buckets. record is a handful of relaxed atomic operations and never allocates, so
+ * it can be called from the haptic loop, and other threads may read the histogram at any time.
+ */
+class LatencyHistogram
+{
+  private:
+    std::atomic<uint64_t> counts[STATS_HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sumNs;
+    std::atomic<uint64_t> maxNs;
+
+  public:
+    LatencyHistogram() { reset(); }
+    void record(double seconds);
+    void reset(void);
+    uint64_t getCount(void) const { return total.load(std::memory_order_relaxed); }
+    void summarize(StatsSummary* summary) const;
+};
+
+void startStats(const char* address, int rpcPort);
+void updateStats(void);
+void stopStats(void);
+void resetStats(void);
+void resetMessageLatencies(void);
+void statsHapticTickStart(void);
+void statsHapticTick(double tickTime);
+void statsFrameStart(void);
+void statsFrame(double frameTime);
+void statsFrameSwap(double sampleTime, double swapTime);
+void statsPrediction(double horizon, double error);
+void statsMessageReceived(const MSG_HEADER& header, double receiveTime);
+void statsMessageParsed(const MSG_HEADER& header, double parseStart, double parseEnd);
+void getLatestStats(StatsPageData* data);
+std::map<std::string, double> getStats(void);
+
+#endif
@@ -0,0 +1,58 @@
+#include "timing.h"
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+/**
+ * @file timing.h
+ * @file timing.cpp
+ * @brief Monotonic clock shared by the haptic, graphics and messaging threads.
+ *
+ * All loop timing and sample stamps in this module are taken from getSteadyTime, so times recorded
+ * on different threads can be compared directly. Messages sent to MessageHandler are stamped on
+ * its clock instead, see getMessageHandlerTime.
+ */
+
+#define SLEEP_SPIN_MARGIN 0.0002 // seconds before a deadline at which sleepUntil stops sleeping and spins
+
+static const chrono::steady_clock::time_point steadyEpoch = chrono::steady_clock::now();
+
+/**
+ * Seconds on the steady clock since the program started.
+ */
+double getSteadyTime(void)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - steadyEpoch).count();
+}
+
+/**
+ * @param deadline Absolute time on the getSteadyTime clock
+ *
+ * Blocks until deadline. The thread sleeps until shortly before the deadline and spins for the
+ * rest, so wake-up jitter does not depend on the scheduler's timer resolution.
+ */
+void sleepUntil(double deadline)
+{
+  double remaining = deadline - getSteadyTime();
+  if (remaining > SLEEP_SPIN_MARGIN) {
+    this_thread::sleep_for(chrono::duration<double>(remaining - SLEEP_SPIN_MARGIN));
+  }
+  while (getSteadyTime() < deadline) {
+    this_thread::yield();
+  }
+}
+
+/**
+ * @param deadline Absolute time on the getSteadyTime clock
+ *
+ * Sleeps until about deadline, without the final spin of sleepUntil. For periodic housekeeping
+ * that only needs to wake roughly on time.
+ */
+void sleepCoarselyUntil(double deadline)
+{
+  double remaining = deadline - getSteadyTime();
+  if (remaining > 0) {
+    this_thread::sleep_for(chrono::duration<double>(remaining));
+  }
+}
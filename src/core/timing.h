@@ -0,0 +1,10 @@
+#pragma once
+
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+double getSteadyTime(void);
+void sleepUntil(double deadline);
+void sleepCoarselyUntil(double deadline);
+
+#endif
@@ -0,0 +1,190 @@
+#include "trace.h"
+
+#include "core/debug.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @file trace.h
+ * @file trace.cpp
+ * @brief Timeline tracing of the haptic, graphics and messaging threads
+ *
+ * Built with HAPTIC_TRACE defined, TRACE_ZONE and the other macros in trace.h record events into a
+ * ring owned by the calling thread. Recording an event is a copy into the next slot plus one
+ * atomic store, with no locks. The ring keeps the last TRACE_RING_EVENTS events and overwrites older
+ * ones, so tracing can stay on for a whole session. Built without it, the macros expand to nothing
+ * and their arguments are not evaluated.
+ *
+ * dumpTrace writes the events of every thread as a Chrome trace (JSON), which chrome://tracing and
+ * ui.perfetto.dev open directly. Zones become complete events on their thread's track. Message
+ * events carry the message's serial_no and msg_type, and a flow arrow joins the packet's receipt on
+ * the listener to its parsing.
+ */
+
+struct TraceThreadBuffer
+{
+  TraceEvent events[TRACE_RING_EVENTS];
+  atomic<uint64_t> written{0}; // events recorded so far
+  char name[32];
+  int threadNum;
+};
+
+static mutex bufferListLock; // guards threadBuffers
+static vector<TraceThreadBuffer*> threadBuffers;
+static mutex dumpLock;
+static string traceFile = TRACE_DEFAULT_FILE;
+static thread_local TraceThreadBuffer* localBuffer = NULL;
+
+/**
+ * Returns the calling thread's ring, creating and registering it on first use.
+ */
+static TraceThreadBuffer* getThreadBuffer()
+{
+  if (localBuffer == NULL) {
+    TraceThreadBuffer* buffer = new TraceThreadBuffer();
+    lock_guard<mutex> lock(bufferListLock);
+    buffer->threadNum = (int) threadBuffers.size();
+    snprintf(buffer->name, sizeof(buffer->name), "thread %d", buffer->threadNum);
+    threadBuffers.push_back(buffer);
+    localBuffer = buffer;
+  }
+  return localBuffer;
+}
+
+/**
+ * Appends an event to the calling thread's ring. Use the TRACE_* macros rather than calling this
+ * directly, so that the call disappears when tracing is compiled out.
+ */
+void traceEvent(int type, const char* name, double start, double duration, int id, int arg)
+{
+  TraceThreadBuffer* buffer = getThreadBuffer();
+  uint64_t written = buffer->written.load(memory_order_relaxed);
+  TraceEvent& event = buffer->events[written % TRACE_RING_EVENTS];
+  event.name = name;
+  event.start = start;
+  event.duration = duration;
+  event.type = type;
+  event.id = id;
+  event.arg = arg;
+  buffer->written.store(written + 1, memory_order_release);
+}
+
+/**
+ * @param name Name shown for the calling thread's track, such as "haptics"
+ */
+void setTraceThreadName(const char* name)
+{
+  TraceThreadBuffer* buffer = getThreadBuffer();
+  strncpy(buffer->name, name, sizeof(buffer->name) - 1);
+  buffer->name[sizeof(buffer->name) - 1] = '\0';
+}
+
+/**
+ * @param path File written by dumpTrace when it is not given one, and at close
+ */
+void setTraceFile(const char* path)
+{
+  lock_guard<mutex> lock(dumpLock);
+  traceFile = path;
+}
+
+bool isTraceEnabled(void)
+{
+#ifdef HAPTIC_TRACE
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Copies the events of one thread that are still in its ring, oldest first. Events that the
+ * thread overwrote while they were being copied are left out.
+ */
+static void snapshotEvents(TraceThreadBuffer* buffer, vector<TraceEvent>* events)
+{
+  uint64_t end = buffer->written.load(memory_order_acquire);
+  uint64_t begin = (end > TRACE_RING_EVENTS) ? end - TRACE_RING_EVENTS : 0;
+  events->clear();
+  for (uint64_t i = begin; i < end; i++) {
+    events->push_back(buffer->events[i % TRACE_RING_EVENTS]);
+  }
+  uint64_t after = buffer->written.load(memory_order_acquire);
+  uint64_t firstValid = (after >= TRACE_RING_EVENTS) ? after - TRACE_RING_EVENTS + 1 : 0;
+  if (firstValid > begin) {
+    size_t stale = (size_t) min<uint64_t>(firstValid - begin, events->size());
+    events->erase(events->begin(), events->begin() + stale);
+  }
+}
+
+/**
+ * @param path File to write, or NULL or "" for the file set with setTraceFile
+ *
+ * Writes the events recorded so far on every thread as a Chrome trace. The threads keep recording
+ * while this runs. Returns false if the file could not be written.
+ */
+bool dumpTrace(const char* path)
+{
+  lock_guard<mutex> lock(dumpLock);
+  string fileName = (path != NULL && path[0] != '\0') ? string(path) : traceFile;
+  FILE* out = fopen(fileName.c_str(), "w");
+  if (out == NULL) {
+    LOG_ERROR("Could not open trace file %s", fileName);
+    return false;
+  }
+  vector<TraceThreadBuffer*> buffers;
+  {
+    lock_guard<mutex> listLock(bufferListLock);
+    buffers = threadBuffers;
+  }
+
+  fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"HapticEnvironment\"}}");
+  vector<TraceEvent> events;
+  size_t eventCount = 0;
+  for (size_t b = 0; b < buffers.size(); b++) {
+    TraceThreadBuffer* buffer = buffers[b];
+    int tid = buffer->threadNum;
+    fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", tid, buffer->name);
+    snapshotEvents(buffer, &events);
+    for (size_t i = 0; i < events.size(); i++) {
+      const TraceEvent& e = events[i];
+      double ts = e.start*1e6;
+      switch (e.type)
+      {
+        case TRACE_EVENT_ZONE:
+          fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"zone\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d", e.name, ts, e.duration*1e6, tid);
+          break;
+
+        case TRACE_EVENT_INSTANT:
+          fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"event\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d", e.name, ts, tid);
+          break;
+
+        case TRACE_EVENT_FLOW_START:
+          fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"message\",\"ph\":\"s\",\"id\":%d,\"ts\":%.3f,\"pid\":1,\"tid\":%d", e.name, e.id, ts, tid);
+          break;
+
+        case TRACE_EVENT_FLOW_END:
+          fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"message\",\"ph\":\"f\",\"bp\":\"e\",\"id\":%d,\"ts\":%.3f,\"pid\":1,\"tid\":%d", e.name, e.id, ts, tid);
+          break;
+      }
+      if (e.id >= 0 || e.arg >= 0) {
+        fprintf(out, ",\"args\":{\"serial_no\":%d,\"msg_type\":%d}", e.id, e.arg);
+      }
+      fprintf(out, "}");
+    }
+    eventCount += events.size();
+  }
+  fprintf(out, "\n]}\n");
+  bool ok = (ferror(out) == 0);
+  fclose(out);
+  LOG_INFO("Wrote %llu trace events to %s", (unsigned long long) eventCount, fileName);
+  return ok;
+}
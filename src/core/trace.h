@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+#define TRACE_RING_EVENTS 65536 // events kept per thread; older ones are overwritten
+#define TRACE_DEFAULT_FILE "trace.json"
+
+#define TRACE_EVENT_ZONE 0
+#define TRACE_EVENT_INSTANT 1
+#define TRACE_EVENT_FLOW_START 2
+#define TRACE_EVENT_FLOW_END 3
+
+/**
+ * One timeline event. name must be a string literal. id links flow events and is the serial_no of
+ * the message for message events; arg is the msg_type.
+ */
+struct TraceEvent
+{
+  const char* name;
+  double start; // getSteadyTime
+  double duration; // zones only
+  int type; // TRACE_EVENT_*
+  int id;
+  int arg;
+};
+
+void traceEvent(int type, const char* name, double start, double duration, int id, int arg);
+void setTraceThreadName(const char* name);
+void setTraceFile(const char* path);
+bool dumpTrace(const char* path);
+bool isTraceEnabled(void);
+
+#ifdef HAPTIC_TRACE
+
+#include "timing.h"
+
+/**
+ * Records the lifetime of a scope as a zone on the current thread's timeline.
+ */
+class TraceZone
+{
+  private:
+    const char* name;
+    double start;
+    int id;
+    int arg;
+
+  public:
+    TraceZone(const char* zoneName, int zoneId = -1, int zoneArg = -1)
+      : name(zoneName), start(getSteadyTime()), id(zoneId), arg(zoneArg) {}
+    ~TraceZone() { traceEvent(TRACE_EVENT_ZONE, name, start, getSteadyTime() - start, id, arg); }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Times the enclosing scope
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+// Times the enclosing scope and tags it with a message's serial_no and msg_type
+#define TRACE_ZONE_MESSAGE(name, serial, msgType) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name, serial, msgType)
+// Starts or ends the flow arrow of a message, keyed by its serial_no, inside the current zone
+#define TRACE_MESSAGE_START(serial, msgType) traceEvent(TRACE_EVENT_FLOW_START, "message", getSteadyTime(), 0.0, serial, msgType)
+#define TRACE_MESSAGE_END(serial, msgType) traceEvent(TRACE_EVENT_FLOW_END, "message", getSteadyTime(), 0.0, serial, msgType)
+#define TRACE_INSTANT(name) traceEvent(TRACE_EVENT_INSTANT, name, getSteadyTime(), 0.0, -1, -1)
+#define TRACE_MESSAGE_INSTANT(name, serial, msgType) traceEvent(TRACE_EVENT_INSTANT, name, getSteadyTime(), 0.0, serial, msgType)
+#define TRACE_THREAD_NAME(name) setTraceThreadName(name)
+
+#else
+
+#define TRACE_ZONE(name) do {} while (0)
+#define TRACE_ZONE_MESSAGE(name, serial, msgType) do {} while (0)
+#define TRACE_MESSAGE_START(serial, msgType) do {} while (0)
+#define TRACE_MESSAGE_END(serial, msgType) do {} while (0)
+#define TRACE_INSTANT(name) do {} while (0)
+#define TRACE_MESSAGE_INSTANT(name, serial, msgType) do {} while (0)
+#define TRACE_THREAD_NAME(name) do {} while (0)
+
+#endif
+
+#endif
@@ -13,7 +13,8 @@ using namespace std;
  * @brief A generic abstract class for any object that moves across the screen at regular time intervals.
  * 
  * All objects that move must inherit this class and override the graphicsLoopFunction. This
- * function is called in the graphics update loop for each moving object in the environment. 
+ * function is called in the graphics update loop for each moving object in the environment. Every
+ * object gets the same dt in a frame: the time on the steady clock since the previous frame.
  */
 class cGenericMovingObject : public cGenericObject 
 {
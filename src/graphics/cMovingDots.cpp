@@ -1,4 +1,110 @@
 #include "cMovingDots.h"
+#include <math.h>
+#include <time.h>
+
+#define DOTS_ANGLES 1024 // directions a random dot can take, a power of two
+#define DOTS_ANGLE_BITS 10
+
+/**
+ * Cosine and sine of DOTS_ANGLES evenly spaced directions, shared by every cMovingDots.
+ */
+struct DotAngleTable
+{
+  float cosine[DOTS_ANGLES];
+  float sine[DOTS_ANGLES];
+
+  DotAngleTable()
+  {
+    for (int a = 0; a < DOTS_ANGLES; a++) {
+      double degrees = 360.0*a/DOTS_ANGLES;
+      cosine[a] = (float) cCosDeg(degrees);
+      sine[a] = (float) cSinDeg(degrees);
+    }
+  }
+};
+
+static const DotAngleTable& angleTable()
+{
+  static const DotAngleTable table;
+  return table;
+}
+
+/**
+ * Counter-based random numbers: the result depends only on key and counter, so each dot draws its
+ * own numbers without a generator state carried from one dot to the next, and the loops that use
+ * it vectorize. The mixing function is Chris Wellons' lowbias32.
+ */
+static inline uint32_t dotRandom(uint32_t key, uint32_t counter)
+{
+  uint32_t x = counter*0x9E3779B9u + key;
+  x ^= x >> 16;
+  x *= 0x7FEB352Du;
+  x ^= x >> 15;
+  x *= 0x846CA68Bu;
+  x ^= x >> 16;
+  return x;
+}
+
+/**
+ * Maps random bits to [-1, 1).
+ */
+static inline float dotCoordinate(uint32_t bits)
+{
+  return (float) (int32_t) bits*(1.0f/2147483648.0f);
+}
+
+/**
+ * Moves every dot by (dy, dz). Dots that leave the field of view are placed at a random position
+ * inside it. The replacement is drawn for every dot and blended in with a 0 or 1 weight, rather
+ * than branched to, so the loop has no branches and vectorizes.
+ */
+static void moveDots(float* __restrict y, float* __restrict z, uint32_t count, float dy, float dz, uint32_t key)
+{
+  for (uint32_t i = 0; i < count; i++) {
+    float newY = y[i] + dy;
+    float newZ = z[i] + dz;
+    float out = (float) ((fabsf(newY) > 1.0f) | (fabsf(newZ) > 1.0f));
+    float spawnY = dotCoordinate(dotRandom(key, 2*i));
+    float spawnZ = dotCoordinate(dotRandom(key, 2*i + 1));
+    y[i] = newY + out*(spawnY - newY);
+    z[i] = newZ + out*(spawnZ - newZ);
+  }
+}
+
+/**
+ * Moves every dot by step in its own random direction, taken from the angle table, then places
+ * dots that left the field of view as moveDots does.
+ */
+static void walkDots(float* __restrict y, float* __restrict z, uint32_t count, float step, uint32_t walkKey,
+  uint32_t spawnKey)
+{
+  const DotAngleTable& table = angleTable();
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t angle = dotRandom(walkKey, i) >> (32 - DOTS_ANGLE_BITS);
+    float newY = y[i] + step*table.cosine[angle];
+    float newZ = z[i] + step*table.sine[angle];
+    float out = (float) ((fabsf(newY) > 1.0f) | (fabsf(newZ) > 1.0f));
+    float spawnY = dotCoordinate(dotRandom(spawnKey, 2*i));
+    float spawnZ = dotCoordinate(dotRandom(spawnKey, 2*i + 1));
+    y[i] = newY + out*(spawnY - newY);
+    z[i] = newZ + out*(spawnZ - newZ);
+  }
+}
+
+/**
+ * Writes the positions into the point cloud in one pass.
+ */
+static void copyDots(cStreamingPoints* points, const vector<float>& y, const vector<float>& z)
+{
+  float* __restrict positions = points->getPositions();
+  size_t count = y.size();
+  for (size_t i = 0; i < count; i++) {
+    positions[3*i] = 0.0f;
+    positions[3*i + 1] = y[i];
+    positions[3*i + 2] = z[i];
+  }
+  points->markPositionsChanged();
+}
 
 /**
  * @param n Number of points 
@@ -9,27 +115,27 @@
  * @brief Constructor for moving dot object 
  *
  * This function generates a dot at a random position in the field of view and adds a pointer to the
- * dots using Chai3D's cMultiPoint object. For each set of moving dots, \a c*n points are chosen to
+ * dots using cStreamingPoints objects. For each set of moving dots, \a c*n points are chosen to
  * be the "movingDots", or dots that move in the direction specified. The remainder of the points
  * <em> (n-(c*n)) </em> are dots that move in random directions.
  */
 cMovingDots::cMovingDots(int n, double c, double d, double m) : cGenericMovingObject()
 {
-  generator.seed(time(0));
-  uniform_real_distribution<double> distribution(-1.0, 1.0);
+  seed = dotRandom((uint32_t) time(0), 0);
+  frame = 0;
 
-  movingPoints = new cMultiPoint();
-  randomPoints = new cMultiPoint();
+  movingPoints = new cStreamingPoints();
+  randomPoints = new cStreamingPoints();
   
-  movingPoints->setPointSize(5.0);
+  movingPoints->setPointSize(5.0f);
   movingPoints->setLocalPos(0.0, 0.0, 0.0);
   movingPoints->setEnabled(true);
-  movingPoints->setUseDisplayList(true);
+  movingPoints->setPointColor(cColorf(1.0f, 1.0f, 1.0f, 1.0f));
 
-  randomPoints->setPointSize(5.0);
+  randomPoints->setPointSize(5.0f);
   randomPoints->setLocalPos(0.0, 0.0, 0.0);
   randomPoints->setEnabled(true);
-  randomPoints->setUseDisplayList(true);
+  randomPoints->setPointColor(cColorf(1.0f, 1.0f, 1.0f, 1.0f));
 
   numDots = n;
   coherence = c;
@@ -38,24 +144,28 @@ cMovingDots::cMovingDots(int n, double c, double d, double m) : cGenericMovingOb
  
   int numMove = (int) (coherence * numDots);
   int numRand = numDots - numMove;
+  movingY.resize(numMove);
+  movingZ.resize(numMove);
+  randomY.resize(numRand);
+  randomZ.resize(numRand);
   
+  uint32_t movingKey = dotRandom(seed, 0xFFFFFFFEu);
   for (int n=0; n<numMove; n++)
   {
-    double x = distribution(generator);
-    double y = distribution(generator);
-    int vId = movingPoints->newVertex(0.0, x, y);
-    int pId = movingPoints->newPoint(vId);
-    movingPoints->setPointColor(cColorf(255.0, 255.0, 255.0, 1.0));
+    movingY[n] = dotCoordinate(dotRandom(movingKey, 2*n));
+    movingZ[n] = dotCoordinate(dotRandom(movingKey, 2*n + 1));
   }
+  movingPoints->setNumPoints(numMove);
+  copyDots(movingPoints, movingY, movingZ);
    
+  uint32_t randomKey = dotRandom(seed, 0xFFFFFFFFu);
   for (int n=0; n<numRand; n++)
   {
-    double x = distribution(generator);
-    double y = distribution(generator);
-    int vId = randomPoints->newVertex(0.0, x, y);
-    randomPoints->newPoint(vId);
-    randomPoints->setPointColor(cColorf(255.0, 255.0, 255.0, 1.0));
+    randomY[n] = dotCoordinate(dotRandom(randomKey, 2*n));
+    randomZ[n] = dotCoordinate(dotRandom(randomKey, 2*n + 1));
   }
+  randomPoints->setNumPoints(numRand);
+  copyDots(randomPoints, randomY, randomZ);
 }
 
 /**
@@ -70,56 +180,29 @@ cMovingDots::cMovingDots(int n, double c, double d, double m) : cGenericMovingOb
  * velocity, and re-renders the dot accordingly. Each random dot is assigned a 
  * random velocity and direction to move. If the dot moves out of the field of view, it's
  * position is randomly selected to be within the field of view. 
+ *
+ * Each frame draws its random numbers under keys derived from the seed and the frame count, so
+ * nothing is allocated and no generator state is shared between dots.
  */
 void cMovingDots::graphicsLoopFunction(double dt, cVector3d toolPos, cVector3d toolVel)
 {
-  uniform_real_distribution<double> distribution(-1.0, 1.0);
-  uniform_real_distribution<double> vDist(0.0, 360.0);
+  frame++;
+  float step = (float) (dt * magnitude);
+  float dy = step * (float) cCosDeg(direction);
+  float dz = step * (float) cSinDeg(direction);
 
-  double xOffset = dt * magnitude * cCosDeg(direction);
-  double yOffset = dt * magnitude * cSinDeg(direction);
-  cVector3d* vOffset = new cVector3d(0.0, xOffset, yOffset);
-  movingPoints->offsetVertices(*vOffset);
-  
-  int numVertices = movingPoints->getNumVertices();
-  cVertexArrayPtr vertices = movingPoints->m_vertices;
-  for (int i = 0; i < numVertices; i++)
-  {
-    double xCoord = vertices->getLocalPos(i).y();
-    double yCoord = vertices->getLocalPos(i).z();
-    if (xCoord > 1.0 || xCoord < -1.0 || yCoord > 1.0 || yCoord < -1.0)
-    {
-      double newX = distribution(generator);
-      double newY = distribution(generator);
-      vertices->setLocalPos(i, 0.0, newX, newY);
-    }
-  }
-  
-  cVertexArrayPtr randVert = randomPoints->m_vertices;
-  for (int i = 0; i < randomPoints->getNumVertices(); i++)
-  {
-    double randomDeg = vDist(generator);
-    double xRand = dt * magnitude * cCosDeg(randomDeg);
-    double yRand = dt * magnitude * cSinDeg(randomDeg);
-    double newX = randVert->getLocalPos(i).y() + xRand;
-    double newY = randVert->getLocalPos(i).z() + yRand;
-    randVert->setLocalPos(i, 0.0, newX, newY);
-
-    if (newX > 1.0 || newX < -1.0 || newY > 1.0 || newY < -1.0)
-    {
-      double newX = distribution(generator);
-      double newY = distribution(generator);
-      randVert->setLocalPos(i, 0.0, newX, newY);
-    }
-  }
-  movingPoints->markForUpdate();
-  randomPoints->markForUpdate();
+  moveDots(movingY.data(), movingZ.data(), (uint32_t) movingY.size(), dy, dz, dotRandom(seed, 3*frame));
+  walkDots(randomY.data(), randomZ.data(), (uint32_t) randomY.size(), step, dotRandom(seed, 3*frame + 1),
+    dotRandom(seed, 3*frame + 2));
+
+  copyDots(movingPoints, movingY, movingZ);
+  copyDots(randomPoints, randomY, randomZ);
 }
 
 /**
  * Returns the dots moving in the specified direction
  */
-cMultiPoint* cMovingDots::getMovingPoints()
+cStreamingPoints* cMovingDots::getMovingPoints()
 {
   return movingPoints; 
 }
@@ -127,7 +210,7 @@ cMultiPoint* cMovingDots::getMovingPoints()
 /**
  * Returns the dots moving in random directions. If coherence is 1, the number of random dots is 0.
  */
-cMultiPoint* cMovingDots::getRandomPoints()
+cStreamingPoints* cMovingDots::getRandomPoints()
 {
   return randomPoints;
 }
@@ -1,8 +1,9 @@
 #pragma once
 #include "chai3d.h"
 #include "cGenericMovingObject.h"
-#include <random>
-#include <ctime>
+#include "cStreamingPoints.h"
+#include <stdint.h>
+#include <vector>
 
 /**
  * @file cMovingDots.h
@@ -15,6 +16,10 @@
  * Essentially, the implementation of Movshon & Newsome's moving dot graphics.
  * Creates a cloud of moving points, where <em> c% </em> of points are moving according to the
  * direction and velocity given, while the remainder of the points move in random directions.
+ *
+ * Dot positions are kept in float arrays, one per coordinate, and updated in plain loops that the
+ * compiler can vectorize. They are copied into the streamed point clouds once per frame, after the
+ * update.
  */
 class cMovingDots : public cGenericMovingObject
 {
@@ -23,13 +28,18 @@ class cMovingDots : public cGenericMovingObject
     double coherence;
     double direction;
     double magnitude;
-    cMultiPoint* movingPoints;
-    cMultiPoint* randomPoints;
-    default_random_engine generator;
+    cStreamingPoints* movingPoints;
+    cStreamingPoints* randomPoints;
+    vector<float> movingY;
+    vector<float> movingZ;
+    vector<float> randomY;
+    vector<float> randomZ;
+    uint32_t seed;
+    uint32_t frame;
 
   public:
     cMovingDots(int n, double c, double d, double m);
     virtual void graphicsLoopFunction(double dt, cVector3d toolPos, cVector3d toolVel); 
-    cMultiPoint* getMovingPoints();
-    cMultiPoint* getRandomPoints();
+    cStreamingPoints* getMovingPoints();
+    cStreamingPoints* getRandomPoints();
 };
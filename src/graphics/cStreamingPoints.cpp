@@ -0,0 +1,301 @@
+#include "cStreamingPoints.h"
+#include "../core/logger.h"
+#include <mutex>
+#include <string.h>
+
+/**
+ * @file cStreamingPoints.h
+ * @file cStreamingPoints.cpp
+ * @brief Point cloud streamed to the GPU every frame
+ *
+ * With OpenGL 4.4 or ARB_buffer_storage, the points go to a buffer that is mapped once and stays
+ * mapped. The buffer holds STREAMING_REGIONS copies of the cloud; each upload writes the next
+ * region in place while the GPU may still be drawing the others, and a fence per region stops an
+ * upload from overwriting a region the GPU has not finished with. Otherwise, with OpenGL 1.5, the
+ * buffer's storage is orphaned before each upload so the driver hands out fresh memory instead of
+ * waiting for the previous draw. Without buffer objects the points are drawn from client memory.
+ * Mesa's software renderer supports all three, so the streaming paths can be tested without a GPU.
+ *
+ * All OpenGL calls are made on the render thread, from render and releaseRetiredBuffers. A cloud
+ * may be destroyed on any thread, such as the listener's, so its destructor only queues its
+ * buffer, and the render thread deletes it before the next frame.
+ */
+
+/**
+ * A buffer and its fences, left behind by a destroyed cloud.
+ */
+struct RetiredBuffer
+{
+  unsigned int buffer;
+  void* fences[STREAMING_REGIONS];
+};
+
+static mutex retiredLock; // guards retiredBuffers
+static vector<RetiredBuffer> retiredBuffers;
+
+/**
+ * Deletes a buffer and its fences. Deleting a mapped buffer also unmaps it. Render thread only.
+ */
+static void deleteBuffer(unsigned int buffer, void** fences)
+{
+#ifdef GLEW_VERSION
+  for (int r = 0; r < STREAMING_REGIONS; r++) {
+    if (fences[r] != NULL) {
+      glDeleteSync((GLsync) fences[r]);
+    }
+  }
+  if (buffer != 0) {
+    glDeleteBuffers(1, &buffer);
+  }
+#else
+  (void) buffer;
+  (void) fences;
+#endif
+}
+
+cStreamingPoints::cStreamingPoints() : cGenericObject()
+{
+  numPoints = 0;
+  positionsChanged = false;
+  pointSize = 1.0f;
+  pointColor = cColorf(1.0f, 1.0f, 1.0f, 1.0f);
+  mode = STREAMING_MODE_UNSET;
+  buffer = 0;
+  capacity = 0;
+  mapped = NULL;
+  for (int r = 0; r < STREAMING_REGIONS; r++) {
+    fences[r] = NULL;
+  }
+  region = 0;
+  uploadedPoints = 0;
+}
+
+cStreamingPoints::~cStreamingPoints()
+{
+  retireBuffer();
+}
+
+/**
+ * @param n Number of points
+ *
+ * Resizes the cloud. Positions of new points are undefined until they are written.
+ */
+void cStreamingPoints::setNumPoints(unsigned int n)
+{
+  numPoints = n;
+  positions.resize(3*(size_t) n);
+  positionsChanged = true;
+}
+
+unsigned int cStreamingPoints::getNumPoints() const
+{
+  return numPoints;
+}
+
+/**
+ * Returns the positions, x, y and z for each point in turn. Call markPositionsChanged after
+ * writing them.
+ */
+float* cStreamingPoints::getPositions()
+{
+  return positions.data();
+}
+
+/**
+ * Uploads the positions with the next render.
+ */
+void cStreamingPoints::markPositionsChanged()
+{
+  positionsChanged = true;
+}
+
+void cStreamingPoints::setPointSize(float size)
+{
+  pointSize = size;
+}
+
+void cStreamingPoints::setPointColor(const cColorf& color)
+{
+  pointColor = color;
+}
+
+/**
+ * @param a_mode STREAMING_MODE_* to use from the next render, or STREAMING_MODE_UNSET to choose
+ * from what the context supports
+ *
+ * Forces an upload path, for testing drivers. The path must be supported by the context.
+ */
+void cStreamingPoints::setMode(int a_mode)
+{
+  retireBuffer();
+  mode = a_mode;
+  positionsChanged = true;
+}
+
+/**
+ * Deletes the buffers of destroyed clouds. Called by the render thread before each frame.
+ */
+void cStreamingPoints::releaseRetiredBuffers()
+{
+  vector<RetiredBuffer> retired;
+  {
+    lock_guard<mutex> lock(retiredLock);
+    if (retiredBuffers.empty()) {
+      return;
+    }
+    retired.swap(retiredBuffers);
+  }
+  for (size_t i = 0; i < retired.size(); i++) {
+    deleteBuffer(retired[i].buffer, retired[i].fences);
+  }
+}
+
+void cStreamingPoints::chooseMode()
+{
+#ifdef GLEW_VERSION
+  if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+    mode = STREAMING_MODE_PERSISTENT;
+  }
+  else if (GLEW_VERSION_1_5) {
+    mode = STREAMING_MODE_ORPHAN;
+  }
+  else {
+    mode = STREAMING_MODE_CLIENT;
+  }
+#else
+  mode = STREAMING_MODE_CLIENT;
+#endif
+}
+
+/**
+ * Hands the buffer to releaseRetiredBuffers, without OpenGL calls. Safe on any thread.
+ */
+void cStreamingPoints::retireBuffer()
+{
+  if (buffer != 0) {
+    RetiredBuffer retired;
+    retired.buffer = buffer;
+    memcpy(retired.fences, fences, sizeof(fences));
+    lock_guard<mutex> lock(retiredLock);
+    retiredBuffers.push_back(retired);
+  }
+  buffer = 0;
+  mapped = NULL;
+  memset(fences, 0, sizeof(fences));
+  capacity = 0;
+  uploadedPoints = 0;
+}
+
+/**
+ * Deletes the buffer at once. Render thread only.
+ */
+void cStreamingPoints::releaseBuffer()
+{
+  deleteBuffer(buffer, fences);
+  buffer = 0;
+  mapped = NULL;
+  memset(fences, 0, sizeof(fences));
+  capacity = 0;
+}
+
+/**
+ * Copies the positions into the vertex buffer. Leaves the buffer bound.
+ */
+void cStreamingPoints::upload()
+{
+#ifdef GLEW_VERSION
+  size_t pointBytes = 3*sizeof(float);
+  if (mode == STREAMING_MODE_PERSISTENT) {
+    if (numPoints > capacity) {
+      releaseBuffer();
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      GLsizeiptr size = (GLsizeiptr) (STREAMING_REGIONS*numPoints*pointBytes);
+      glGenBuffers(1, &buffer);
+      glBindBuffer(GL_ARRAY_BUFFER, buffer);
+      glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+      mapped = (char*) glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+      if (mapped == NULL) {
+        LOG_WARN("Could not map a streaming vertex buffer; orphaning buffers instead");
+        releaseBuffer();
+        mode = STREAMING_MODE_ORPHAN;
+        upload();
+        return;
+      }
+      capacity = numPoints;
+    }
+    region = (region + 1) % STREAMING_REGIONS;
+    if (fences[region] != NULL) {
+      glClientWaitSync((GLsync) fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, STREAMING_FENCE_TIMEOUT);
+      glDeleteSync((GLsync) fences[region]);
+      fences[region] = NULL;
+    }
+    memcpy(mapped + region*capacity*pointBytes, positions.data(), numPoints*pointBytes);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  }
+  else if (mode == STREAMING_MODE_ORPHAN) {
+    if (buffer == 0) {
+      glGenBuffers(1, &buffer);
+    }
+    capacity = max(capacity, numPoints);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (capacity*pointBytes), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr) (numPoints*pointBytes), positions.data());
+  }
+#endif
+  uploadedPoints = numPoints;
+}
+
+/**
+ * Draws the points as they were last uploaded, without lighting. The lighting state is restored
+ * afterwards.
+ */
+void cStreamingPoints::render(cRenderOptions& a_options)
+{
+  if (!SECTION_RENDER_OPAQUE_PARTS_ONLY(a_options) || a_options.m_creating_shadow_map) {
+    return;
+  }
+  releaseRetiredBuffers();
+  if (mode == STREAMING_MODE_UNSET) {
+    chooseMode();
+  }
+  if (positionsChanged) {
+    upload();
+    positionsChanged = false;
+  }
+  if (uploadedPoints == 0) {
+    return;
+  }
+
+  GLboolean lighting = glIsEnabled(GL_LIGHTING);
+  glDisable(GL_LIGHTING);
+  glPointSize(pointSize);
+  pointColor.render();
+  glEnableClientState(GL_VERTEX_ARRAY);
+#ifdef GLEW_VERSION
+  if (mode != STREAMING_MODE_CLIENT) {
+    size_t offset = (mode == STREAMING_MODE_PERSISTENT) ? region*capacity*3*sizeof(float) : 0;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexPointer(3, GL_FLOAT, 0, (const GLvoid*) offset);
+  }
+  else
+#endif
+  {
+    glVertexPointer(3, GL_FLOAT, 0, positions.data());
+  }
+  glDrawArrays(GL_POINTS, 0, (GLsizei) uploadedPoints);
+  glDisableClientState(GL_VERTEX_ARRAY);
+#ifdef GLEW_VERSION
+  if (mode != STREAMING_MODE_CLIENT) {
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  if (mode == STREAMING_MODE_PERSISTENT) {
+    if (fences[region] != NULL) {
+      glDeleteSync((GLsync) fences[region]);
+    }
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+#endif
+  if (lighting) {
+    glEnable(GL_LIGHTING);
+  }
+}
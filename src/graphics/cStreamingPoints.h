@@ -0,0 +1,66 @@
+#pragma once
+
+#include "chai3d.h"
+#include <vector>
+
+using namespace chai3d;
+using namespace std;
+
+// How the points reach the GPU, chosen from what the context supports
+#define STREAMING_MODE_UNSET 0
+#define STREAMING_MODE_PERSISTENT 1 // buffer mapped once, written in place, one region per frame in flight
+#define STREAMING_MODE_ORPHAN 2 // buffer storage orphaned and refilled every frame
+#define STREAMING_MODE_CLIENT 3 // client-side vertex array, without buffer objects
+#define STREAMING_REGIONS 3 // regions of a persistently mapped buffer
+#define STREAMING_FENCE_TIMEOUT 100000000 // nanoseconds to wait for the GPU to release a region
+
+/**
+ * @file cStreamingPoints.h
+ *
+ * @class cStreamingPoints
+ *
+ * @brief A point cloud whose positions change every frame
+ *
+ * cMultiPoint keeps its points in a display list or in buffers sized for static geometry, so
+ * changing every point every frame recompiles or reallocates them. cStreamingPoints streams the
+ * positions to the GPU instead: write them with getPositions, call markPositionsChanged, and the
+ * next render copies them into a vertex buffer that is reused from frame to frame.
+ *
+ * test/streamingPointsTest.cpp draws through each mode on an offscreen Mesa context.
+ */
+class cStreamingPoints : public cGenericObject
+{
+  private:
+    vector<float> positions; // x, y, z of each point
+    unsigned int numPoints;
+    bool positionsChanged;
+    float pointSize;
+    cColorf pointColor;
+    int mode; // STREAMING_MODE_*, chosen on the first render unless set
+    unsigned int buffer;
+    unsigned int capacity; // points the buffer holds, per region when mapped
+    char* mapped; // persistently mapped buffer, STREAMING_REGIONS regions of capacity points
+    void* fences[STREAMING_REGIONS];
+    int region; // region the last upload went to
+    unsigned int uploadedPoints; // points in the last upload
+
+    void chooseMode();
+    void retireBuffer();
+    void releaseBuffer();
+    void upload();
+
+  public:
+    cStreamingPoints();
+    virtual ~cStreamingPoints();
+    void setNumPoints(unsigned int n);
+    unsigned int getNumPoints() const;
+    float* getPositions();
+    void markPositionsChanged();
+    void setPointSize(float size);
+    void setPointColor(const cColorf& color);
+    void setMode(int a_mode);
+    static void releaseRetiredBuffers();
+
+  protected:
+    virtual void render(cRenderOptions& a_options);
+};
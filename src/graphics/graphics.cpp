@@ -1,5 +1,11 @@
 #include "graphics.h"
 #include "../core/debug.h"
+#include "../core/flightRecorder.h"
+#include "../core/stats.h"
+#include "../core/timing.h"
+#include "../core/trace.h"
+#include "platform_compat.h"
+#include <mutex>
 #include <sstream>
 #include <iomanip>
 
@@ -8,15 +14,38 @@
  * @file graphics.cpp
  * @brief Functions for setting up and starting the graphics loop.
  *
- * The graphics loop is the main loop of the program. Haptics runs in its own loop and messaging is
- * handled by a separate thread. The functions here are responsible for using GLFW libraries to
- * initialize and update the display.
+ * Frames are drawn by a render thread that owns the OpenGL context. The main thread only waits for
+ * window events: GLFW requires its callbacks to run there, and they hand anything the render thread
+ * needs to it through a small queue. Key presses are queued for the publisher, so input handling
+ * never waits for a frame and a slow callback never delays one. Haptics runs in its own loop and
+ * messaging is handled by separate threads. The functions here are responsible for using GLFW
+ * libraries to initialize and update the display.
  */
 
 extern HapticData hapticsData;
 extern ControlData controlData;
 GraphicsData graphicsData;
 
+static bool swapQueriesAvailable = false;
+static GLuint swapQueries[GRAPHICS_SWAP_QUERIES];
+static double swapSampleTimes[GRAPHICS_SWAP_QUERIES]; // frameSampleTime of the frame behind each query
+static uint64_t swapsQueried = 0;
+static uint64_t swapsRead = 0;
+static double refreshPeriod = 1.0/60.0; // of the primary monitor
+static double vsyncTime = -1.0; // when the last swap's glFinish returned, with --gl-finish; close to vertical sync
+static double renderBudget = 0.0; // recent worst time from the start of a frame to its swap
+static double nextFrameTime = 0.0; // start of the next frame in the capped mode
+static double measuredLatency = -1.0; // smoothed time from a frame's tool state to its swap
+static double predictionTimes[GRAPHICS_PREDICTION_RING]; // time each pending prediction is for
+static double predictionHorizons[GRAPHICS_PREDICTION_RING];
+static cVector3d predictedPositions[GRAPHICS_PREDICTION_RING];
+static uint64_t predictionsMade = 0;
+static uint64_t predictionsChecked = 0;
+static cShapeSphere* predictedCursor = NULL; // drawn in place of the tool with --predict
+static mutex eventLock; // guards pendingEvents
+static mutex renderStopLock; // one stopRenderThread at a time
+static vector<GraphicsEvent> pendingEvents; // posted by the main thread, drained by the render thread
+
 /**
  * Creates and initializes a GLFW window, and stores a pointer to this window in the graphicsData
  * struct. This does not initialize the Chai3D graphics information. For that, @see initScene
@@ -64,7 +93,18 @@ void initDisplay(void)
     graphicsData.height = h;
     graphicsData.xPos = x;
     graphicsData.yPos = y;
-    graphicsData.swapInterval = 1;  
+    if (graphicsData.framePacing == GRAPHICS_PACING_LATCHED && !graphicsData.finishAfterSwap) {
+        LOG_WARN("Latched frame pacing needs --gl-finish to find vertical sync; using vsync pacing");
+        graphicsData.framePacing = GRAPHICS_PACING_VSYNC;
+    }
+    graphicsData.swapInterval = (graphicsData.framePacing == GRAPHICS_PACING_CAPPED) ? 0 : 1;
+    if (mode->refreshRate > 0) {
+        refreshPeriod = 1.0/mode->refreshRate;
+    }
+    graphicsData.frameTick = 0;
+    graphicsData.frameSampleTime = -1.0;
+    graphicsData.frameTime = -1.0;
+    graphicsData.frameDt = 0.0;
 
     debug_log(__FILE__, __LINE__, __FUNCTION__, "Creating GLFW window...");
     graphicsData.window = glfwCreateWindow(w, h, "CHAI3D", NULL, NULL);
@@ -94,7 +134,21 @@ void initDisplay(void)
         return;
     }
     debug_log(__FILE__, __LINE__, __FUNCTION__, "GLEW initialized successfully");
+
+    swapQueriesAvailable = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (swapQueriesAvailable) {
+        glGenQueries(GRAPHICS_SWAP_QUERIES, swapQueries);
+    }
 #endif
+    if (swapQueriesAvailable) {
+        LOG_INFO("Buffer swaps timed with GPU timestamp queries");
+    }
+    else if (graphicsData.finishAfterSwap) {
+        LOG_INFO("Buffer swaps timed with the CPU clock after glFinish");
+    }
+    else {
+        LOG_INFO("Timer queries are not available; run with --gl-finish to measure swap latency");
+    }
 
     debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("OpenGL Version: " + std::string(reinterpret_cast<const char*>(glGetString(GL_VERSION)))).c_str());
     debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("OpenGL Vendor: " + std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR)))).c_str());
@@ -151,8 +205,7 @@ void initScene(void)
  */
 void resizeWindowCallback(GLFWwindow* a_window, int a_width, int a_height)
 {
-    graphicsData.width = a_width;
-    graphicsData.height = a_height;
+    postGraphicsEvent(GRAPHICS_EVENT_RESIZE, a_width, a_height);
 }
 
 /**
@@ -178,41 +231,39 @@ void errorCallback(int error, const char* errorDescription)
  */
 void keySelectCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
-    debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("Key pressed: " + std::to_string(key)).c_str());
+    LOG_DEBUG("Key pressed: %d", key);
     
     try {
         if ((action != GLFW_PRESS) && (action != GLFW_REPEAT)) {
-            debug_log(__FILE__, __LINE__, __FUNCTION__, "Ignoring non-press action");
+            LOG_DEBUG("Ignoring non-press action");
             return;
         }
         else if ((key == GLFW_KEY_ESCAPE) || (key == GLFW_KEY_Q)) {
-            debug_log(__FILE__, __LINE__, __FUNCTION__, "Closing window");
+            LOG_DEBUG("Closing window");
             glfwSetWindowShouldClose(window, GLFW_TRUE);
         }
         else if(key == GLFW_KEY_F) {
-            debug_log(__FILE__, __LINE__, __FUNCTION__, "Toggling fullscreen");
+            LOG_DEBUG("Toggling fullscreen");
             graphicsData.fullscreen = !graphicsData.fullscreen;
             GLFWmonitor* monitor = glfwGetPrimaryMonitor();
             const GLFWvidmode* mode = glfwGetVideoMode(monitor);
             if (graphicsData.fullscreen) {
                 glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
-                glfwSwapInterval(graphicsData.swapInterval);
+                postGraphicsEvent(GRAPHICS_EVENT_SWAP_INTERVAL, 0, 0);
             }
             else {
                 int w = 0.8 * mode->height;
                 int h = 0.5 * mode->height;
                 int x = 0.5 * (mode->width - w);
                 int y = 0.5 * (mode->height - h);
-                graphicsData.width = w;
-                graphicsData.height = h;
                 graphicsData.xPos = x;
                 graphicsData.yPos = y;
                 glfwSetWindowMonitor(window, NULL, x, y, w, h, mode->refreshRate);
-                glfwSwapInterval(graphicsData.swapInterval);
+                postGraphicsEvent(GRAPHICS_EVENT_SWAP_INTERVAL, 0, 0);
             }
         }
         else {
-            debug_log(__FILE__, __LINE__, __FUNCTION__, "Processing regular key press");
+            LOG_DEBUG("Processing regular key press");
             const char* key_name;
             if (key == 32) {
                 key_name = "space";
@@ -222,77 +273,411 @@ void keySelectCallback(GLFWwindow* window, int key, int scancode, int action, in
             }
             
             if (!key_name) {
-                debug_log(__FILE__, __LINE__, __FUNCTION__, "Warning: Could not get key name");
+                LOG_WARN("Could not get key name");
                 return;
             }
             
-            debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("Key name: " + std::string(key_name)).c_str());
+            LOG_DEBUG("Key name: %s", key_name);
             
             M_KEYPRESS keypressEvent;
             memset(&keypressEvent, 0, sizeof(keypressEvent));
-            
-            debug_log(__FILE__, __LINE__, __FUNCTION__, "Getting message number");
-            auto packetNum = controlData.client->call("getMsgNum").as<int>();
-            
-            debug_log(__FILE__, __LINE__, __FUNCTION__, "Getting timestamp");
-            auto currTime = controlData.client->call("getTimestamp").as<double>();
-            
-            keypressEvent.header.serial_no = packetNum;
             keypressEvent.header.msg_type = KEYPRESS;
-            keypressEvent.header.timestamp = currTime;
-            memcpy(&(keypressEvent.keyname), key_name, sizeof(keypressEvent.keyname));
-            
-            char* packet[sizeof(keypressEvent)];
-            memcpy(&packet, &keypressEvent, sizeof(keypressEvent));
+            keypressEvent.header.timestamp = getMessageHandlerTime();
+            strncpy(keypressEvent.keyname, key_name, sizeof(keypressEvent.keyname) - 1);
             
-            debug_log(__FILE__, __LINE__, __FUNCTION__, "Sending message");
-            auto res = controlData.client->call("sendMessage", (char* const) packet, sizeof(packet), controlData.MODULE_NUM).as<int>();
-            
-            if (res == 1) {
-                debug_log(__FILE__, __LINE__, __FUNCTION__, "Successfully sent KEYPRESS message");
+            if (publishMessage(&keypressEvent, sizeof(keypressEvent))) {
+                LOG_DEBUG("Queued KEYPRESS message");
             }
             else {
-                debug_log(__FILE__, __LINE__, __FUNCTION__, "Failed to send KEYPRESS message");
+                LOG_WARN("Failed to queue KEYPRESS message");
             }
         }
     } catch (const std::exception& e) {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("Exception in keySelectCallback: " + std::string(e.what())).c_str());
+        LOG_ERROR("Exception in keySelectCallback: %s", e.what());
         throw;
     } catch (...) {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, "Unknown exception in keySelectCallback");
+        LOG_ERROR("Unknown exception in keySelectCallback");
         throw;
     }
 }
 
+/**
+ * @param type GRAPHICS_EVENT_*
+ * @param width New width, for GRAPHICS_EVENT_RESIZE
+ * @param height New height, for GRAPHICS_EVENT_RESIZE
+ *
+ * Queues a window event for the render thread, which handles it before its next frame. Called
+ * from GLFW callbacks on the main thread.
+ */
+void postGraphicsEvent(int type, int width, int height)
+{
+    GraphicsEvent event;
+    event.type = type;
+    event.width = width;
+    event.height = height;
+    lock_guard<mutex> lock(eventLock);
+    pendingEvents.push_back(event);
+}
+
+/**
+ * Handles the window events posted since the last frame. Render thread only.
+ */
+static void processGraphicsEvents(void)
+{
+    vector<GraphicsEvent> events;
+    {
+        lock_guard<mutex> lock(eventLock);
+        if (pendingEvents.empty()) {
+            return;
+        }
+        events.swap(pendingEvents);
+    }
+    for (size_t i = 0; i < events.size(); i++) {
+        if (events[i].type == GRAPHICS_EVENT_RESIZE) {
+            graphicsData.width = events[i].width;
+            graphicsData.height = events[i].height;
+        }
+        else if (events[i].type == GRAPHICS_EVENT_SWAP_INTERVAL) {
+            glfwSwapInterval(graphicsData.swapInterval);
+        }
+    }
+}
+
+/**
+ * Hands the OpenGL context over to a new render thread. Called from the main thread once
+ * everything the frames depend on has been started.
+ */
+void startRenderThread(void)
+{
+    glfwMakeContextCurrent(NULL);
+    graphicsData.renderRunning = true;
+    graphicsData.renderUp = true;
+    graphicsData.renderThread = new cThread();
+    graphicsData.renderThread->start(updateRender, CTHREAD_PRIORITY_GRAPHICS);
+}
+
+/**
+ * Render thread. Makes the OpenGL context current and draws frames, as paced by paceFrame, until
+ * stopRenderThread is called.
+ */
+void updateRender(void)
+{
+    TRACE_THREAD_NAME("graphics");
+    glfwMakeContextCurrent(graphicsData.window);
+    glfwSwapInterval(graphicsData.swapInterval);
+    while (graphicsData.renderRunning.load()) {
+        try {
+            processGraphicsEvents();
+            cStreamingPoints::releaseRetiredBuffers();
+            paceFrame();
+            double frameStart = getSteadyTime();
+            statsFrameStart();
+            updateGraphics();
+            graphicsData.freqCounterGraphics.signal(1);
+            double frameEnd = getSteadyTime();
+            statsFrame(frameEnd);
+            flightRecordFrame(graphicsData.frameTick, frameStart, frameEnd);
+        } catch (const std::exception& e) {
+            debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("Exception in render loop: " + std::string(e.what())).c_str());
+            print_stack_trace();
+            throw;
+        } catch (...) {
+            debug_log(__FILE__, __LINE__, __FUNCTION__, "Unknown exception in render loop");
+            print_stack_trace();
+            throw;
+        }
+    }
+    glfwMakeContextCurrent(NULL);
+    graphicsData.renderUp = false;
+}
+
+/**
+ * Stops the render thread and waits for it to release the OpenGL context. May be called from any
+ * thread, and more than once: close stops it from the listener before deleting the world, and main
+ * stops it after the window is closed.
+ */
+void stopRenderThread(void)
+{
+    lock_guard<mutex> lock(renderStopLock);
+    graphicsData.renderRunning = false;
+    while (graphicsData.renderUp.load()) {
+        platform::usleep(1000);
+    }
+    delete graphicsData.renderThread;
+    graphicsData.renderThread = NULL;
+}
+
+/**
+ * @param sampleTime Time of the tool state a frame rendered
+ * @param swapTime Time at which the frame's swap completed
+ *
+ * Notes a measured swap, for pacing, prediction and the statistics.
+ */
+static void recordSwap(double sampleTime, double swapTime)
+{
+    double latency = swapTime - sampleTime;
+    measuredLatency = (measuredLatency < 0.0) ? latency : measuredLatency + 0.05*(latency - measuredLatency);
+    statsFrameSwap(sampleTime, swapTime);
+}
+
+/**
+ * Queues a GPU timestamp behind the buffer swap that was just issued. Its result is the time the
+ * GPU got through the swap, and is read back by readSwapQueries a frame or two later without
+ * stalling. If every query is still outstanding, the frame goes unmeasured.
+ */
+static void querySwap(void)
+{
+#ifdef GLEW_VERSION
+    if (swapsQueried - swapsRead == GRAPHICS_SWAP_QUERIES) {
+        return;
+    }
+    int slot = (int) (swapsQueried & (GRAPHICS_SWAP_QUERIES - 1));
+    glQueryCounter(swapQueries[slot], GL_TIMESTAMP);
+    swapSampleTimes[slot] = graphicsData.frameSampleTime;
+    swapsQueried++;
+#endif
+}
+
+/**
+ * Records the sample-to-swap latency of every queried frame whose timestamp has arrived. GPU times
+ * are put on the getSteadyTime clock by reading both clocks together once per call.
+ */
+static void readSwapQueries(void)
+{
+#ifdef GLEW_VERSION
+    if (swapsRead == swapsQueried) {
+        return;
+    }
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    double offset = getSteadyTime() - gpuNow*1e-9;
+    while (swapsRead < swapsQueried) {
+        int slot = (int) (swapsRead & (GRAPHICS_SWAP_QUERIES - 1));
+        GLint available = 0;
+        glGetQueryObjectiv(swapQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 gpuSwap = 0;
+        glGetQueryObjectui64v(swapQueries[slot], GL_QUERY_RESULT, &gpuSwap);
+        recordSwap(swapSampleTimes[slot], gpuSwap*1e-9 + offset);
+        swapsRead++;
+    }
+#endif
+}
+
+/**
+ * @param sample Tool state the frame renders
+ * @param toolPos Set to the predicted position
+ * @param toolVel Set to the predicted velocity
+ *
+ * Extrapolates the tool state to when the frame is expected on screen: the prediction horizon
+ * past the state's time, or the measured latency from state to swap if no horizon was given. With
+ * GRAPHICS_PREDICT_ACCELERATION the acceleration is the change in velocity over the filter window,
+ * which smooths the noise a single tick would add. The prediction is kept until the true position
+ * is known, see checkPredictions.
+ */
+static void predictTool(const HapticSample& sample, cVector3d& toolPos, cVector3d& toolVel)
+{
+    double horizon = graphicsData.predictionHorizon;
+    if (horizon <= 0.0) {
+        horizon = (measuredLatency > 0.0) ? measuredLatency : refreshPeriod;
+    }
+    cVector3d pos(sample.pos[0], sample.pos[1], sample.pos[2]);
+    cVector3d vel(sample.vel[0], sample.vel[1], sample.vel[2]);
+    cVector3d acc(0.0, 0.0, 0.0);
+    HapticSample past;
+    if (graphicsData.prediction == GRAPHICS_PREDICT_ACCELERATION
+        && getHapticSampleAt(sample.time - graphicsData.predictionFilter, past) && past.time < sample.time) {
+        double span = sample.time - past.time;
+        acc.set((sample.vel[0] - past.vel[0])/span, (sample.vel[1] - past.vel[1])/span, (sample.vel[2] - past.vel[2])/span);
+    }
+    toolPos = pos + horizon*vel + (0.5*horizon*horizon)*acc;
+    toolVel = vel + horizon*acc;
+
+    if (predictionsMade - predictionsChecked == GRAPHICS_PREDICTION_RING) {
+        predictionsChecked++;
+    }
+    int slot = (int) (predictionsMade & (GRAPHICS_PREDICTION_RING - 1));
+    predictionTimes[slot] = sample.time + horizon;
+    predictionHorizons[slot] = horizon;
+    predictedPositions[slot] = toolPos;
+    predictionsMade++;
+}
+
+/**
+ * @param offset Predicted position minus the position the prediction started from
+ *
+ * Draws the tool cursor ahead by offset. The CHAI3D tool is drawn by its own, live, state, so with
+ * --predict it is hidden and a sphere like its proxy is drawn at the proxy position plus offset.
+ * The cursor therefore still stops at surfaces the proxy is held against.
+ */
+static void showPredictedCursor(const cVector3d& offset)
+{
+    if (predictedCursor == NULL) {
+        predictedCursor = new cShapeSphere(HAPTIC_TOOL_RADIUS);
+        predictedCursor->m_material->setRed();
+        predictedCursor->setHapticEnabled(false);
+        graphicsData.world->addChild(predictedCursor);
+        hapticsData.tool->setShowEnabled(false, true);
+    }
+    predictedCursor->setLocalPos(hapticsData.tool->m_hapticPoint->getGlobalPosProxy() + offset);
+}
+
+/**
+ * Compares the predictions whose time has passed with the tool's true position at that time, and
+ * records the distance in the statistics. Predictions whose time has dropped out of the haptic
+ * history are skipped.
+ */
+static void checkPredictions(void)
+{
+    HapticSample latest;
+    if (predictionsChecked == predictionsMade || !getLatestHapticSample(latest)) {
+        return;
+    }
+    while (predictionsChecked < predictionsMade) {
+        int slot = (int) (predictionsChecked & (GRAPHICS_PREDICTION_RING - 1));
+        if (predictionTimes[slot] > latest.time) {
+            break;
+        }
+        HapticSample truth;
+        if (getHapticSampleAt(predictionTimes[slot], truth) && truth.time == predictionTimes[slot]) {
+            cVector3d truePos(truth.pos[0], truth.pos[1], truth.pos[2]);
+            statsPrediction(predictionHorizons[slot], cDistance(truePos, predictedPositions[slot]));
+        }
+        predictionsChecked++;
+    }
+}
+
+/**
+ * Returns true if a light in the world renders a shadow map. Only spot lights can.
+ */
+static bool worldHasShadows(void)
+{
+    for (int i = 0; i < graphicsData.world->getNumLights(); i++) {
+        cSpotLight* light = dynamic_cast<cSpotLight*>(graphicsData.world->getLightSource(i));
+        if (light != NULL && light->getShadowMapEnabled()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Called from the main loop before each frame, and waits until the frame should start. With vsync
+ * pacing it returns at once and the swap waits instead. Capped pacing sleeps until the next slot
+ * of the frame rate cap, without catching up on slots that were missed. Latched pacing sleeps
+ * until just enough time is left to render the frame before the next vertical sync, judging by
+ * the slowest recent frames, so the tool state it latches is as fresh as possible. The sync times
+ * are extrapolated from the last time glFinish returned after a swap. Neither a GPU timestamp,
+ * which marks when the GPU finished rather than vertical sync, nor the return of an unfinished
+ * swap is locked to the display, so latched pacing falls back to vsync without --gl-finish.
+ */
+void paceFrame(void)
+{
+    double now = getSteadyTime();
+    if (graphicsData.framePacing == GRAPHICS_PACING_CAPPED) {
+        double period = 1.0/graphicsData.frameRateCap;
+        nextFrameTime += period;
+        if (nextFrameTime < now - period) {
+            nextFrameTime = now;
+        }
+        sleepUntil(nextFrameTime);
+    }
+    else if (graphicsData.framePacing == GRAPHICS_PACING_LATCHED && vsyncTime > 0.0) {
+        double lead = 1.5*renderBudget + GRAPHICS_LATCH_MARGIN;
+        double swap = vsyncTime + ceil((now + lead - vsyncTime)/refreshPeriod)*refreshPeriod;
+        sleepUntil(swap - lead);
+    }
+}
+
 /**
  * updateGraphics is called from the main loop and updates the graphics at each time step. Each
  * update involves updating the shadows and camera view, as well as rendering the updated position
  * of any moving objects. All moving objects must override the graphicsLoopFunction method.
+ *
+ * Each frame has one time, frameTime, taken on the steady clock just before drawing. Every moving
+ * object is given the same frameDt since the previous frame, so animation speed does not depend on
+ * CPU load or on the order of the objects. The tool state is the haptic history interpolated to
+ * frameTime, or the latest tick if none is newer, and moving objects are updated with it before
+ * the view is rendered, so they appear in the same frame. With --predict, the position and
+ * velocity they are given, and the tool cursor on screen, are extrapolated to when the frame is
+ * expected on screen, see predictTool and showPredictedCursor. The frame is stamped with that
+ * tick, and when the swap has completed, the time from the state's time to the swap is recorded
+ * as the frame's latency (graphics.swapLatency in the statistics). Without --predict the tool is
+ * drawn from its live state, which is never older than the stamp, so the latency is an upper
+ * bound on how stale the cursor on screen is. Shadow maps are only updated if a light casts
+ * shadows. glFinish is only called with --gl-finish; the CPU otherwise goes on to the next frame
+ * while the GPU works.
  */
 void updateGraphics(void)
 {
+    TRACE_ZONE("updateGraphics");
     try {
         // debug_log(__FILE__, __LINE__, __FUNCTION__, "Updating graphics");
-        graphicsData.world->updateShadowMaps(false, graphicsData.mirroredDisplay);
-        graphicsData.camera->renderView(graphicsData.width, graphicsData.height);
+        double renderStart = getSteadyTime();
+        if (worldHasShadows()) {
+            graphicsData.world->updateShadowMaps(false, graphicsData.mirroredDisplay);
+        }
+
+        double frameTime = getSteadyTime();
+        graphicsData.frameDt = (graphicsData.frameTime >= 0.0) ? frameTime - graphicsData.frameTime : 0.0;
+        graphicsData.frameTime = frameTime;
+
+        HapticSample sample;
+        bool stamped = getHapticSampleAt(frameTime, sample);
+        cVector3d toolPos = hapticsData.tool->getDeviceGlobalPos();
+        cVector3d toolVel = hapticsData.tool->getDeviceGlobalLinVel();
+        cVector3d predictionOffset(0.0, 0.0, 0.0);
+        if (stamped) {
+            toolPos.set(sample.pos[0], sample.pos[1], sample.pos[2]);
+            toolVel.set(sample.vel[0], sample.vel[1], sample.vel[2]);
+            graphicsData.frameTick = sample.tick;
+            graphicsData.frameSampleTime = sample.time;
+            if (graphicsData.prediction != GRAPHICS_PREDICT_OFF) {
+                cVector3d samplePos = toolPos;
+                checkPredictions();
+                predictTool(sample, toolPos, toolVel);
+                predictionOffset = toolPos - samplePos;
+            }
+        }
+        if (graphicsData.prediction != GRAPHICS_PREDICT_OFF) {
+            showPredictedCursor(predictionOffset);
+        }
 
         for(vector<cGenericMovingObject*>::iterator it = graphicsData.movingObjects.begin(); it != graphicsData.movingObjects.end(); it++)
         {
-            double dt = (clock() - graphicsData.graphicsClock)/double(CLOCKS_PER_SEC);
-            graphicsData.graphicsClock = clock();
-
-            (*it)->graphicsLoopFunction(dt, hapticsData.tool->getDeviceGlobalPos(), hapticsData.tool->getDeviceGlobalLinVel());
+            (*it)->graphicsLoopFunction(graphicsData.frameDt, toolPos, toolVel);
         }
+
+        graphicsData.camera->renderView(graphicsData.width, graphicsData.height);
+        double renderTime = getSteadyTime() - renderStart;
+        renderBudget = (renderTime > renderBudget*0.99) ? renderTime : renderBudget*0.99; // decays over about a second
    
-        glfwSwapBuffers(graphicsData.window);
-        glFinish();
+        {
+            TRACE_ZONE("swapBuffers");
+            glfwSwapBuffers(graphicsData.window);
+            if (swapQueriesAvailable && stamped) {
+                querySwap();
+            }
+            if (graphicsData.finishAfterSwap) {
+                glFinish();
+                vsyncTime = getSteadyTime();
+            }
+        }
+        if (swapQueriesAvailable) {
+            readSwapQueries();
+        }
+        else if (stamped && graphicsData.finishAfterSwap) {
+            recordSwap(sample.time, vsyncTime);
+        }
    
         GLenum err = glGetError();
         if (err != GL_NO_ERROR) {
-            debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("OpenGL Error: " + std::string((char*)gluErrorString(err))).c_str());
+            LOG_ERROR("OpenGL Error: %s", (const char*) gluErrorString(err));
         }
     } catch (const std::exception& e) {
-        debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("Exception in updateGraphics: " + std::string(e.what())).c_str());
+        LOG_ERROR("Exception in updateGraphics: %s", e.what());
         throw;
     } catch (...) {
         debug_log(__FILE__, __LINE__, __FUNCTION__, "Unknown exception in updateGraphics");
@@ -6,12 +6,41 @@
 #include "chai3d.h"
 #include <GLFW/glfw3.h>
 #include "haptics/haptics.h"
+#include <atomic>
 #include <vector>
 
+#define GRAPHICS_SWAP_QUERIES 8 // buffer swaps whose GPU timestamps may be outstanding, power of two
+
+// Frame pacing modes (--frame-pacing)
+#define GRAPHICS_PACING_VSYNC 0 // render as soon as the previous swap returns, swaps wait for vertical sync
+#define GRAPHICS_PACING_CAPPED 1 // no vertical sync, frames start on a fixed schedule of frameRateCap per second
+#define GRAPHICS_PACING_LATCHED 2 // vertical sync, frames start as late as the render time allows
+#define GRAPHICS_FRAME_RATE_DEFAULT 120.0 // frame rate cap in the capped mode
+#define GRAPHICS_LATCH_MARGIN 0.001 // seconds of slack kept before vertical sync in the latched mode
+
+// Cursor prediction (--predict)
+#define GRAPHICS_PREDICT_OFF 0
+#define GRAPHICS_PREDICT_VELOCITY 1 // extrapolate with the tool velocity
+#define GRAPHICS_PREDICT_ACCELERATION 2 // and with the acceleration over the filter window
+#define GRAPHICS_PREDICT_FILTER_DEFAULT 0.010 // seconds over which the acceleration is averaged
+#define GRAPHICS_PREDICTION_RING 64 // predictions waiting for the true position, power of two
+
+// Window events passed from the main thread to the render thread
+#define GRAPHICS_EVENT_RESIZE 0
+#define GRAPHICS_EVENT_SWAP_INTERVAL 1 // the window changed monitor, so the swap interval is set again
+
+struct GraphicsEvent
+{
+  int type; // GRAPHICS_EVENT_*
+  int width;
+  int height;
+};
+
 // ------------------------------------------------------
 // -------------Custom Graphics Functionality------------
 // ------------------------------------------------------
 #include "cGenericMovingObject.h"
+#include "cStreamingPoints.h"
 #include "cMovingDots.h"
 #include "cPipe.h"
 #include "cArrow.h"
@@ -32,10 +61,22 @@ struct GraphicsData {
   int xPos;
   int yPos;
   int swapInterval;
+  int framePacing; // GRAPHICS_PACING_*
+  double frameRateCap; // frames per second in the capped mode
+  bool finishAfterSwap; // call glFinish after each swap (--gl-finish)
+  int prediction; // GRAPHICS_PREDICT_*
+  double predictionHorizon; // seconds ahead of the tool state, 0 to use the measured swap latency
+  double predictionFilter; // seconds over which the acceleration is averaged
+  cThread* renderThread; // owns the OpenGL context while it runs
+  atomic<bool> renderRunning;
+  atomic<bool> renderUp;
   cShapeTorus* object;
   cFrequencyCounter freqCounterGraphics;
-  clock_t graphicsClock;
+  double frameTime; // getSteadyTime at which the current frame latched the tool state
+  double frameDt; // time since the previous frame's frameTime, 0 for the first frame
   vector<cGenericMovingObject*> movingObjects;
+  uint64_t frameTick; // haptic tick whose tool state the current frame renders
+  double frameSampleTime; // getSteadyTime of that tick's device read, negative before the first tick
 };
 
 void initDisplay(void);
@@ -43,6 +84,11 @@ void initScene(void);
 void errorCallback(int error, const char* errorDescription);
 void resizeWindowCallback(GLFWwindow* window, int w, int h);
 void keySelectCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void postGraphicsEvent(int type, int width, int height);
+void startRenderThread(void);
+void updateRender(void);
+void stopRenderThread(void);
+void paceFrame(void);
 void updateGraphics(void);
 
 #endif
@@ -1,8 +1,16 @@
 #include "haptics.h"
 #include "platform_compat.h"
 #include "../core/debug.h"
+#include "../core/flightRecorder.h"
+#include "../core/perfCounters.h"
+#include "../core/stats.h"
+#include "../core/timing.h"
+#include "../core/trace.h"
+#include "../network/publisher.h"
+#include "../recording/recorder.h"
 #include <sstream>
 #include <iomanip>
+#include <atomic>
 
 /**
  * @file haptics.h 
@@ -18,6 +26,125 @@ HapticData hapticsData;
 extern GraphicsData graphicsData;
 extern ControlData controlData;
 
+/**
+ * Recent haptic ticks, written only by the haptic thread. Each slot is guarded by its own sequence
+ * number (2*tick+1 while being written, 2*tick+2 once complete) so readers on other threads never
+ * block the haptic loop and can tell when a slot was overwritten while they copied it.
+ */
+struct HapticSampleSlot
+{
+  atomic<uint64_t> sequence;
+  HapticSample sample;
+};
+
+static HapticSampleSlot sampleHistory[HAPTIC_SAMPLE_HISTORY];
+static atomic<uint64_t> ticksPublished(0);
+
+/**
+ * Stores the state of the tool for this tick. Called once per tick from the haptic thread.
+ */
+static void publishHapticSample(const HapticSample& sample)
+{
+  HapticSampleSlot& slot = sampleHistory[sample.tick & (HAPTIC_SAMPLE_HISTORY - 1)];
+  slot.sequence.store(2*sample.tick + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy(&slot.sample, &sample, sizeof(sample));
+  slot.sequence.store(2*sample.tick + 2, memory_order_release);
+  ticksPublished.store(sample.tick + 1, memory_order_release);
+}
+
+/**
+ * Recording tap. Appends the tick to the current recording, so every tick is recorded rather than
+ * only the streamed ones. recordRow only copies into a preallocated buffer; the writer thread does
+ * the I/O.
+ */
+static void recordHapticTick(const HapticSample& sample)
+{
+    RecordingRow row;
+    row.tick = (int64_t) sample.tick;
+    row.timestamp = toMessageHandlerTime(sample.time);
+    row.sampleTime = row.timestamp;
+    row.posX = sample.pos[0];
+    row.posY = sample.pos[1];
+    row.posZ = sample.pos[2];
+    row.velX = sample.vel[0];
+    row.velY = sample.vel[1];
+    row.velZ = sample.vel[2];
+    row.forceX = sample.force[0];
+    row.forceY = sample.force[1];
+    row.forceZ = sample.force[2];
+    recordRow(row);
+}
+
+/**
+ * @param tick Index of the haptic tick to read
+ * @param sample Filled with the state of the tool at that tick
+ *
+ * Returns false if the tick has not happened yet or is older than the last HAPTIC_SAMPLE_HISTORY
+ * ticks.
+ */
+bool getHapticSample(uint64_t tick, HapticSample& sample)
+{
+  HapticSampleSlot& slot = sampleHistory[tick & (HAPTIC_SAMPLE_HISTORY - 1)];
+  uint64_t before = slot.sequence.load(memory_order_acquire);
+  if (before != 2*tick + 2) {
+    return false;
+  }
+  memcpy(&sample, &slot.sample, sizeof(sample));
+  atomic_thread_fence(memory_order_acquire);
+  return slot.sequence.load(memory_order_relaxed) == before;
+}
+
+/**
+ * Copies the most recent complete haptic tick into sample. Returns false before the first tick.
+ */
+bool getLatestHapticSample(HapticSample& sample)
+{
+  while (true) {
+    uint64_t published = ticksPublished.load(memory_order_acquire);
+    if (published == 0) {
+      return false;
+    }
+    if (getHapticSample(published - 1, sample)) {
+      return true;
+    }
+  }
+}
+
+/**
+ * @param time Time on the getSteadyTime clock
+ * @param sample Filled with the state of the tool at time
+ *
+ * Interpolates linearly between the two ticks around time, and stamps the result with the later
+ * one. A time after the latest tick gives the latest tick, and a time before the last
+ * HAPTIC_SAMPLE_HISTORY ticks gives the oldest one still kept; sample.time says which time the
+ * state is for. Returns false before the first tick.
+ */
+bool getHapticSampleAt(double time, HapticSample& sample)
+{
+  HapticSample later;
+  if (!getLatestHapticSample(later)) {
+    return false;
+  }
+  HapticSample earlier;
+  while (later.time > time && later.tick > 0 && getHapticSample(later.tick - 1, earlier)) {
+    if (earlier.time <= time) {
+      double f = (time - earlier.time)/(later.time - earlier.time);
+      sample.tick = later.tick;
+      sample.time = time;
+      for (int i = 0; i < 3; i++) {
+        sample.pos[i] = earlier.pos[i] + f*(later.pos[i] - earlier.pos[i]);
+        sample.vel[i] = earlier.vel[i] + f*(later.vel[i] - earlier.vel[i]);
+        sample.force[i] = earlier.force[i] + f*(later.force[i] - earlier.force[i]);
+      }
+      return true;
+    }
+    later = earlier;
+  }
+  sample = later;
+  return true;
+}
+
 /**
  * @brief Initializes the haptic thread. 
  *
@@ -118,7 +245,9 @@ void startHapticsThread(void)
  * @brief Haptic update function 
  *
  * This function is called on each iteration of the haptic loop. It computes the global and local
- * positions of the device and renders any forces based on objects in the Chai3d world
+ * positions of the device and renders any forces based on objects in the Chai3d world. The state of
+ * the tool after each tick is stored as a HapticSample for the streamer and graphics threads, and
+ * is recorded directly when controlData.recordTicks is set.
  */
 void updateHaptics(void)
 {
@@ -127,22 +256,57 @@ void updateHaptics(void)
         cPrecisionClock clock;
         clock.reset();
         cVector3d angVel(0.0, 0.0, 0.1);
+        HapticSample sample;
+        uint64_t tick = 0;
         platform::usleep(500); // give some time for other threads to start up
+        TRACE_THREAD_NAME("haptics");
+        if (controlData.perfCounters) {
+            openPerfCounters();
+        }
         
         while (controlData.simulationRunning) {
+            TRACE_ZONE("hapticTick");
+            double tickStart = getSteadyTime();
+            statsHapticTickStart();
+            perfTickStart();
             clock.stop();
             double timeInterval = clock.getCurrentTimeSeconds();
             clock.reset();
             clock.start();
             
             graphicsData.world->computeGlobalPositions(true);
+            perfPhaseEnd(PERF_PHASE_POSITIONS);
             cVector3d pos = hapticsData.tool->getDeviceLocalPos();
             //cout << pos.x() << ", " << pos.y() << ", " << pos.z() << endl;
             hapticsData.tool->updateFromDevice();
+            perfPhaseEnd(PERF_PHASE_DEVICE_READ);
+            double sampleTime = getSteadyTime();
             hapticsData.tool->computeInteractionForces();
+            perfPhaseEnd(PERF_PHASE_FORCES);
             hapticsData.tool->applyToDevice();
+            perfPhaseEnd(PERF_PHASE_DEVICE_WRITE);
+
+            cVector3d toolPos = hapticsData.tool->getDeviceGlobalPos();
+            cVector3d toolVel = hapticsData.tool->getDeviceGlobalLinVel();
+            cVector3d toolForce = hapticsData.tool->getDeviceGlobalForce();
+            sample.tick = tick++;
+            sample.time = sampleTime;
+            for (int i = 0; i < 3; i++) {
+                sample.pos[i] = toolPos(i);
+                sample.vel[i] = toolVel(i);
+                sample.force[i] = toolForce(i);
+            }
+            publishHapticSample(sample);
+            hapticsData.freqCounterHaptics.signal(1);
+            statsHapticTick(sampleTime);
+            if (controlData.recordTicks.load(memory_order_relaxed) && isRecording()) {
+                recordHapticTick(sample);
+            }
+            perfPhaseEnd(PERF_PHASE_PUBLISH);
+            flightRecordTick(sample, getSteadyTime() - tickStart);
         }
         
+        closePerfCounters();
         controlData.hapticsUp = false;
         debug_log(__FILE__, __LINE__, __FUNCTION__, "Haptics update loop ended");
     } catch (const std::exception& e) {
@@ -4,6 +4,7 @@
 #define _HAPTICS_H_INCLUDED_
 
 #include <stdio.h>
+#include <stdint.h>
 #include "chai3d.h"
 #include "graphics/graphics.h"
 #include "core/controller.h"
@@ -23,11 +24,28 @@ struct HapticData
   double maxForce;
 };
 
+/**
+ * State of the haptic tool at the end of one haptic tick. Position, velocity and force are all
+ * taken from the same tick, in world coordinates. time is on the getSteadyTime clock.
+ */
+struct HapticSample
+{
+  uint64_t tick;
+  double time;
+  double pos[3];
+  double vel[3];
+  double force[3];
+};
+
 #define HAPTIC_TOOL_RADIUS 2
+#define HAPTIC_SAMPLE_HISTORY 256 // number of recent ticks that can be read back (64 ms at 4 kHz), power of two
 
 void initHaptics(void);
 void startHapticsThread(void);
 void updateHaptics(void);
+bool getHapticSample(uint64_t tick, HapticSample& sample);
+bool getLatestHapticSample(HapticSample& sample);
+bool getHapticSampleAt(double time, HapticSample& sample);
 
 
 // ---------------------------------------------------- //
@@ -2,6 +2,10 @@
 #include "haptics/haptics.h"
 #include "network.h"
 #include "core/controller.h"
+#include "core/flightRecorder.h"
+#include "core/stats.h"
+#include "core/timing.h"
+#include "core/trace.h"
 #include "platform_compat.h"
 
 using namespace chai3d;
@@ -37,6 +41,7 @@ void updateListener()
 {
   char rawPacket[MAX_PACKET_LENGTH];
   char* packetPointer = rawPacket;
+  TRACE_THREAD_NAME("listener");
   
   while (controlData.simulationRunning)
   {
@@ -44,6 +49,11 @@ void updateListener()
     int bytesRead = readPacket(packetPointer);
     if (bytesRead > 0) {
       //cout << "Bytes read " << bytesRead << endl;
+      double receiveTime = getSteadyTime();
+      MSG_HEADER header;
+      memcpy(&header, packetPointer, sizeof(header));
+      statsMessageReceived(header, receiveTime);
+      flightRecordMessage(packetPointer, bytesRead, receiveTime);
       parsePacket(packetPointer);
     }
     platform::usleep(100); // 1000 microseconds = 1 millisecond
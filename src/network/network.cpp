@@ -1,6 +1,8 @@
 #include "network.h"
 #include "core/controller.h"
+#include "core/trace.h"
 #include "platform_compat.h"
+#include "MessageHandler.h"
 
 using namespace chai3d;
 using namespace std;
@@ -22,6 +24,11 @@ extern ControlData controlData;
 struct sockaddr_in msgStruct;
 int msgLen = sizeof(msgStruct);
 
+static SequenceTracker sequenceTracker;
+static atomic<uint64_t> packetsRead(0);
+static atomic<uint32_t> kernelDrops(0);
+static bool kernelDropsAvailable = false;
+
 /**
  * This function adds the robot environment to the MessageHandler. Information such as the module
  * number, IP address, and port are set through command-line inputs and stored in the controlData
@@ -29,6 +36,9 @@ int msgLen = sizeof(msgStruct);
  */
 int addMessageHandlerModule()
 {
+  if (controlData.broker != NULL) {
+    return controlData.broker->addModule(controlData.MODULE_NUM, controlData.IPADDR, controlData.PORT);
+  }
   auto addMod = controlData.client->call("addModule", controlData.MODULE_NUM, controlData.IPADDR, controlData.PORT);
   return addMod.as<int>();
 }
@@ -42,9 +52,16 @@ int subscribeToTrialControl()
   bool subscribed = false;
   clock_t begin = clock();
   while (subscribed == false) {
-    auto subscribe = controlData.client->async_call("subscribeTo", 1, 2);
-    subscribe.wait();
-    if (subscribe.get().as<int>() == 1) {
+    int result;
+    if (controlData.broker != NULL) {
+      result = controlData.broker->subscribeTo(1, 2);
+    }
+    else {
+      auto subscribe = controlData.client->async_call("subscribeTo", 1, 2);
+      subscribe.wait();
+      result = subscribe.get().as<int>();
+    }
+    if (result == 1) {
       subscribed = true;
       return 1;
     }
@@ -98,6 +115,13 @@ int openMessagingSocket()
   }
   cout << "Socket options set successfully" << endl;
 
+  kernelDropsAvailable = enableOverflowCounter(controlData.msg_socket);
+  cout << "Receive overflow counter " << (kernelDropsAvailable ? "enabled" : "not supported") << endl;
+  if (controlData.rcvbufAuto) {
+    int granted = autoSizeReceiveBuffer(controlData.msg_socket, RCVBUF_AUTO_PACKET_RATE, RCVBUF_AUTO_PACKET_SIZE, RCVBUF_AUTO_STALL);
+    cout << "Receive buffer sized to " << granted << " bytes" << endl;
+  }
+
   cout << "Binding socket..." << endl;
   int bind_sock_in = platform::bind(controlData.msg_socket, (struct sockaddr*) &msgStruct, msgLen);
   if (bind_sock_in < 0) {
@@ -117,21 +141,49 @@ void closeMessagingSocket()
 }
 
 /**
- * Receives messages on the messaging socket and sends them to be parsed by the controller
+ * Receives messages on the messaging socket and sends them to be parsed by the controller. The
+ * MessageHandler sequence stamp of each packet is checked for loss, duplication and reordering.
  * @param packetPointer is a char pointer to store the read-in bytes
  * @see parsePacket
+ * @see getListenerStats
  */
 int readPacket(char* packetPointer)
 {
   int value = 0, bytesRead = 0;
   platform::ioctl(controlData.msg_socket, FIONREAD, &value);
   if (value > 0) {
-    bytesRead = recvfrom(controlData.msg_socket, packetPointer, MAX_PACKET_LENGTH, 0, (struct sockaddr*) &msgStruct, (socklen_t *) &msgLen);
+    TRACE_ZONE("readPacket");
+    uint32_t overflow = kernelDrops.load(memory_order_relaxed);
+    bytesRead = receivePacket(controlData.msg_socket, packetPointer, MAX_PACKET_LENGTH, &overflow);
+    kernelDrops.store(overflow, memory_order_relaxed);
     //cout << bytesRead << " bytes read from socket" << endl;
+    if (bytesRead >= (int) sizeof(MSG_HEADER)) {
+      MSG_HEADER header;
+      memcpy(&header, packetPointer, sizeof(header));
+      sequenceTracker.observe(header);
+      packetsRead++;
+      TRACE_MESSAGE_START(header.serial_no, header.msg_type);
+    }
   }
   return bytesRead;
 }
 
+/**
+ * Returns the receive statistics of the messaging socket, per source module and msg_type and in
+ * total. Safe to call from any thread.
+ */
+ListenerStats getListenerStats()
+{
+  ListenerStats stats;
+  stats.sources = sequenceTracker.getStats();
+  stats.totals = sequenceTracker.getTotals();
+  stats.packetsRead = packetsRead.load();
+  stats.kernelDrops = kernelDrops.load();
+  stats.kernelDropsAvailable = kernelDropsAvailable;
+  stats.receiveBufferSize = getReceiveBufferSize(controlData.msg_socket);
+  return stats;
+}
+
 /**
  * Close all messaging sockets
  */
@@ -10,6 +10,7 @@
 #endif
 
 #include "messageDefinitions.h"
+#include "messageReceiver.h"
 #include "platform_compat.h"
 #include <stdio.h>
 #include <string.h>
@@ -29,10 +30,29 @@
     #include <fcntl.h>
 #endif
 
+#define RCVBUF_AUTO_PACKET_RATE 4000.0 // packets per second the receive buffer is sized for
+#define RCVBUF_AUTO_PACKET_SIZE 1024 // typical packet size in bytes, including kernel overhead
+#define RCVBUF_AUTO_STALL 0.5 // seconds the listener may stall before the kernel drops packets
+
+/**
+ * Receive statistics for the messaging socket. kernelDrops is the number of packets the kernel
+ * dropped because the receive buffer was full, and is only available where SO_RXQ_OVFL is supported.
+ */
+struct ListenerStats
+{
+  SequenceStats totals;
+  std::vector<SequenceStats> sources;
+  uint64_t packetsRead;
+  uint32_t kernelDrops;
+  bool kernelDropsAvailable;
+  int receiveBufferSize;
+};
+
 int addMessageHandlerModule();
 int subscribeToTrialControl();
 int openMessagingSocket();
 void closeMessagingSocket();
 int readPacket(char* packet);
+ListenerStats getListenerStats();
 
 #endif
@@ -0,0 +1,293 @@
+#include "publisher.h"
+
+#include "haptics/haptics.h"
+#include "network.h"
+#include "platform_compat.h"
+#include "core/debug.h"
+#include "core/timing.h"
+#include "core/trace.h"
+#include "MessageHandler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+using namespace chai3d;
+using namespace std;
+
+/**
+ * @file publisher.h
+ * @file publisher.cpp
+ * @brief Outbound message publisher
+ *
+ * Every message that this module sends to MessageHandler goes through the publisher. The render,
+ * haptic and streamer threads call publishMessage, which copies the packet into a bounded
+ * multi-producer, single-consumer queue and returns without blocking. The publisher thread is the
+ * only user of the rpc::client once the module is registered: it stamps each header with a serial
+ * number from MessageHandler and sends the packet. While the queue is empty it sleeps on a
+ * condition variable; publishMessage only takes the lock to wake it when it is actually asleep.
+ *
+ * Header timestamps are set by the caller with getMessageHandlerTime, which is the local steady
+ * clock corrected to MessageHandler's clock. The publisher thread re-estimates the offset
+ * periodically while the queue is idle.
+ *
+ * With an embedded broker (--embed-broker) the publisher calls MessageHandler directly instead of
+ * through the rpc::client, so messages are routed without serialization or a TCP round trip.
+ */
+
+#define PUBLISHER_CLOCK_SYNC_INTERVAL 1.0 // seconds between clock offset estimates
+#define PUBLISHER_CLOCK_SYNC_SAMPLES 5 // round trips per estimate, the fastest one is kept
+#define PUBLISHER_IDLE_WAIT 0.1 // longest sleep on an empty queue, bounds how late shutdown is noticed
+
+extern ControlData controlData;
+
+struct PublisherSlot
+{
+  atomic<size_t> sequence;
+  uint16_t lengthPacket;
+  double enqueueTime;
+  char packet[MAX_PACKET_LENGTH];
+};
+
+static PublisherSlot* publisherSlots = NULL;
+static atomic<size_t> enqueuePos(0);
+static atomic<size_t> dequeuePos(0);
+static atomic<uint64_t> enqueuedCount(0);
+static atomic<uint64_t> sentCount(0);
+static atomic<uint64_t> droppedCount(0);
+static atomic<uint64_t> failedCount(0);
+static atomic<double> latencySum(0.0);
+static atomic<double> latencyMax(0.0);
+static atomic<double> clockOffset(0.0);
+static mutex wakeLock;
+static condition_variable wakeCondition;
+static atomic<bool> publisherWaiting(false);
+
+/**
+ * Estimates the offset between the local clock and MessageHandler's clock. Several getTimestamp
+ * round trips are made and the one with the shortest round trip is used, assuming the remote
+ * timestamp was taken halfway through it.
+ */
+static void syncClock()
+{
+  if (controlData.broker != NULL) {
+    double t0 = getSteadyTime();
+    double remote = controlData.broker->getTimestamp();
+    double t1 = getSteadyTime();
+    clockOffset.store(remote - 0.5*(t0 + t1));
+    return;
+  }
+  double bestRoundTrip = -1.0;
+  double offset = clockOffset.load();
+  for (int i = 0; i < PUBLISHER_CLOCK_SYNC_SAMPLES; i++) {
+    double t0 = getSteadyTime();
+    double remote = controlData.client->call("getTimestamp").as<double>();
+    double t1 = getSteadyTime();
+    if (bestRoundTrip < 0 || (t1 - t0) < bestRoundTrip) {
+      bestRoundTrip = t1 - t0;
+      offset = remote - 0.5*(t0 + t1);
+    }
+  }
+  clockOffset.store(offset);
+}
+
+static void syncClockLogged()
+{
+  try {
+    syncClock();
+  } catch (const std::exception& e) {
+    LOG_ERROR("Exception syncing clock: %s", e.what());
+  }
+}
+
+static bool packetReady(size_t pos)
+{
+  return publisherSlots[pos & (PUBLISHER_QUEUE_LENGTH - 1)].sequence.load(memory_order_acquire) == pos + 1;
+}
+
+/**
+ * @param pos Queue position the publisher is waiting to send
+ * @param timeout Longest time to sleep, in seconds
+ *
+ * Sleeps until publishMessage fills pos, the simulation stops or the timeout expires.
+ */
+static void waitForPacket(size_t pos, double timeout)
+{
+  unique_lock<mutex> lock(wakeLock);
+  publisherWaiting.store(true);
+  atomic_thread_fence(memory_order_seq_cst);
+  wakeCondition.wait_for(lock, chrono::duration<double>(timeout), [pos] {
+    return packetReady(pos) || !controlData.simulationRunning;
+  });
+  publisherWaiting.store(false);
+}
+
+/**
+ * Stamps the serial number and sends one queued packet through MessageHandler.
+ */
+static void sendSlot(PublisherSlot* slot)
+{
+  TRACE_ZONE("sendMessage");
+  try {
+    MSG_HEADER header;
+    memcpy(&header, slot->packet, sizeof(header));
+    int res;
+    if (controlData.broker != NULL) {
+      header.serial_no = controlData.broker->getMsgNum();
+      memcpy(slot->packet, &header, sizeof(header));
+      TRACE_MESSAGE_INSTANT("send", header.serial_no, header.msg_type);
+      res = controlData.broker->sendMessage((const char*) slot->packet, slot->lengthPacket, controlData.MODULE_NUM);
+    }
+    else {
+      header.serial_no = controlData.client->call("getMsgNum").as<int>();
+      memcpy(slot->packet, &header, sizeof(header));
+      TRACE_MESSAGE_INSTANT("send", header.serial_no, header.msg_type);
+      vector<char> packetData(slot->packet, slot->packet + slot->lengthPacket);
+      res = controlData.client->call("sendMessage", packetData, slot->lengthPacket, controlData.MODULE_NUM).as<int>();
+    }
+    if (res == 1) {
+      sentCount++;
+    }
+    else {
+      failedCount++;
+    }
+  } catch (const std::exception& e) {
+    failedCount++;
+    LOG_ERROR("Exception sending message: %s", e.what());
+  }
+
+  double latency = getSteadyTime() - slot->enqueueTime;
+  latencySum.store(latencySum.load() + latency);
+  double currMax = latencyMax.load();
+  while (latency > currMax && !latencyMax.compare_exchange_weak(currMax, latency)) {}
+}
+
+/**
+ * Allocates the publisher queue, estimates the MessageHandler clock offset and starts the publisher
+ * thread. The pointer to the thread is stored in the ControlData struct. This must be called after
+ * the module has been added to MessageHandler and before any other thread publishes.
+ */
+void startPublisher(void)
+{
+  publisherSlots = new PublisherSlot[PUBLISHER_QUEUE_LENGTH];
+  for (size_t i = 0; i < PUBLISHER_QUEUE_LENGTH; i++) {
+    publisherSlots[i].sequence.store(i, memory_order_relaxed);
+  }
+  syncClockLogged();
+  controlData.publisherUp = true;
+  controlData.publisherThread = new cThread();
+  controlData.publisherThread->start(updatePublisher, CTHREAD_PRIORITY_GRAPHICS);
+}
+
+/**
+ * Publisher thread. Sends queued packets in the order they were published, and refreshes the clock
+ * offset while there is nothing to send. Runs at graphics priority so its blocking RPCs never
+ * compete with the haptic loop.
+ */
+void updatePublisher(void)
+{
+  double lastSync = getSteadyTime();
+  TRACE_THREAD_NAME("publisher");
+  while (controlData.simulationRunning)
+  {
+    size_t pos = dequeuePos.load(memory_order_relaxed);
+    PublisherSlot* slot = &publisherSlots[pos & (PUBLISHER_QUEUE_LENGTH - 1)];
+    if (!packetReady(pos)) {
+      if (getSteadyTime() - lastSync > PUBLISHER_CLOCK_SYNC_INTERVAL) {
+        syncClockLogged();
+        lastSync = getSteadyTime();
+      }
+      double untilSync = lastSync + PUBLISHER_CLOCK_SYNC_INTERVAL - getSteadyTime();
+      waitForPacket(pos, max(0.0, min(untilSync, PUBLISHER_IDLE_WAIT)));
+      continue;
+    }
+    sendSlot(slot);
+    slot->sequence.store(pos + PUBLISHER_QUEUE_LENGTH, memory_order_release);
+    dequeuePos.store(pos + 1, memory_order_relaxed);
+  }
+  controlData.publisherUp = false;
+}
+
+/**
+ * @param packet Pointer to a message, starting with its MSG_HEADER
+ * @param lengthPacket Size of the message in bytes
+ *
+ * Queues a message to be sent by the publisher thread. Safe to call from any thread. Only waits,
+ * briefly, for the publisher's lock when the publisher is asleep and has to be woken. Returns false, and counts the message as dropped, if the queue is full.
+ */
+bool publishMessage(const void* packet, uint16_t lengthPacket)
+{
+  if (publisherSlots == NULL || lengthPacket > MAX_PACKET_LENGTH) {
+    droppedCount++;
+    return false;
+  }
+  size_t pos = enqueuePos.load(memory_order_relaxed);
+  PublisherSlot* slot;
+  while (true) {
+    slot = &publisherSlots[pos & (PUBLISHER_QUEUE_LENGTH - 1)];
+    size_t seq = slot->sequence.load(memory_order_acquire);
+    intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+    if (diff == 0) {
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+        break;
+      }
+    }
+    else if (diff < 0) {
+      droppedCount++;
+      return false;
+    }
+    else {
+      pos = enqueuePos.load(memory_order_relaxed);
+    }
+  }
+  memcpy(slot->packet, packet, lengthPacket);
+  slot->lengthPacket = lengthPacket;
+  slot->enqueueTime = getSteadyTime();
+  slot->sequence.store(pos + 1, memory_order_release);
+  enqueuedCount++;
+  atomic_thread_fence(memory_order_seq_cst);
+  if (publisherWaiting.load()) {
+    { lock_guard<mutex> lock(wakeLock); }
+    wakeCondition.notify_one();
+  }
+  return true;
+}
+
+/**
+ * Returns the current time on MessageHandler's clock, in seconds, estimated from the local clock.
+ * Use this for MSG_HEADER timestamps.
+ */
+double getMessageHandlerTime(void)
+{
+  return getSteadyTime() + clockOffset.load();
+}
+
+/**
+ * @param steadyTime A time on the getSteadyTime clock
+ *
+ * Converts a local time stamp, such as the time of a haptic tick, to MessageHandler's clock.
+ */
+double toMessageHandlerTime(double steadyTime)
+{
+  return steadyTime + clockOffset.load();
+}
+
+/**
+ * Returns a snapshot of the publisher counters.
+ */
+PublisherStats getPublisherStats(void)
+{
+  PublisherStats stats;
+  size_t queued = enqueuePos.load();
+  size_t sent = dequeuePos.load();
+  stats.queueDepth = (queued > sent) ? queued - sent : 0;
+  stats.enqueued = enqueuedCount.load();
+  stats.sent = sentCount.load();
+  stats.dropped = droppedCount.load();
+  stats.failed = failedCount.load();
+  uint64_t handled = stats.sent + stats.failed;
+  stats.meanLatency = (handled > 0) ? latencySum.load()/handled : 0.0;
+  stats.maxLatency = latencyMax.load();
+  return stats;
+}
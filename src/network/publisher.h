@@ -0,0 +1,33 @@
+#pragma once
+
+#ifndef _PUBLISHER_H_
+#define _PUBLISHER_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "chai3d.h"
+
+#define PUBLISHER_QUEUE_LENGTH 512 // must be a power of two
+
+/**
+ * Counters describing the outbound publisher. Latencies are measured from publishMessage to the
+ * return of the sendMessage call, in seconds.
+ */
+struct PublisherStats
+{
+  size_t queueDepth;
+  uint64_t enqueued;
+  uint64_t sent;
+  uint64_t dropped;
+  uint64_t failed;
+  double meanLatency;
+  double maxLatency;
+};
+
+void startPublisher(void);
+void updatePublisher(void);
+bool publishMessage(const void* packet, uint16_t lengthPacket);
+double getMessageHandlerTime(void);
+double toMessageHandlerTime(double steadyTime);
+PublisherStats getPublisherStats(void);
+#endif
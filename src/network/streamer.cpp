@@ -2,7 +2,14 @@
 
 #include "haptics/haptics.h"
 #include "network.h"
+#include "publisher.h"
+#include "recording/recorder.h"
 #include "platform_compat.h"
+#include "core/debug.h"
+#include "core/timing.h"
+#include "core/trace.h"
+#include <atomic>
+#include <cmath>
 
 using namespace chai3d;
 using namespace std;
@@ -18,71 +25,113 @@ using namespace std;
 extern ControlData controlData;
 extern HapticData hapticsData;
 
+static atomic<uint64_t> samplesSent(0);
+static atomic<uint64_t> missedDeadlines(0);
+
 /**
  * Start the data streaming thread. The pointer to the thread is stored in the ControlData struct
  */
 void startStreamer(void)
 {
+  controlData.streamerUp = true;
   controlData.streamerThread = new cThread();
   controlData.streamerThread->start(updateStreamer, CTHREAD_PRIORITY_HAPTICS);
-  controlData.streamerUp = true;
 }
 
 /**
- * Gets and sends the position, velocity, and force data of the robot
+ * @param rate Stream rate in Hz
+ *
+ * Sets the rate of the haptic data stream. The rate is clamped to STREAM_RATE_MIN and
+ * STREAM_RATE_MAX and takes effect at the next sample. Rates that are not finite are ignored.
  */
-void updateStreamer(void)
+void setStreamRate(double rate)
 {
-  cVector3d pos;
-  cVector3d vel;
-  cVector3d force;
+  if (!isfinite(rate)) {
+    LOG_WARN("Ignoring stream rate %f", rate);
+    return;
+  }
+  if (rate < STREAM_RATE_MIN) {
+    rate = STREAM_RATE_MIN;
+  }
+  else if (rate > STREAM_RATE_MAX) {
+    rate = STREAM_RATE_MAX;
+  }
+  controlData.streamRate = rate;
+}
 
-  double posX = 0, posY = 0, posZ = 0;
-  double velX = 0, velY = 0, velZ = 0;
-  double forceX = 0, forceY = 0, forceZ = 0;
+/**
+ * Returns a snapshot of the streamer counters.
+ */
+StreamerStats getStreamerStats(void)
+{
+  StreamerStats stats;
+  stats.rate = controlData.streamRate.load();
+  stats.samplesSent = samplesSent.load();
+  stats.missedDeadlines = missedDeadlines.load();
+  return stats;
+}
+
+/**
+ * Sends the position, velocity, and force data of the robot at controlData.streamRate. Samples are
+ * paced against absolute deadlines, so the rate does not drift with how long sending takes. Each
+ * sample is copied from the most recent haptic tick and carries that tick's index and time. If the
+ * streamer falls more than one period behind, the missed periods are skipped rather than sent in a
+ * burst.
+ */
+void updateStreamer(void)
+{
+  HapticSample sample;
+  double rate = controlData.streamRate.load();
+  double period = 1.0/rate;
+  double startTime = getSteadyTime();
+  uint64_t periodNum = 0;
+  TRACE_THREAD_NAME("streamer");
 
-  cPrecisionClock clock;
   while (controlData.simulationRunning)
   {
-    pos = hapticsData.tool->getDeviceGlobalPos();
-    posX = pos.x();
-    posY = pos.y();
-    posZ = pos.z();
-    vel = hapticsData.tool->getDeviceGlobalLinVel();
-    velX = vel.x();
-    velY = vel.y();
-    velZ = vel.z();
+    double newRate = controlData.streamRate.load();
+    if (newRate != rate) {
+      rate = newRate;
+      period = 1.0/rate;
+      startTime = getSteadyTime();
+      periodNum = 0;
+    }
+    double deadline = startTime + periodNum*period;
+    double now = getSteadyTime();
+    if (now > deadline + period) {
+      uint64_t behind = (uint64_t) ((now - startTime)/period);
+      missedDeadlines += behind - periodNum;
+      periodNum = behind;
+      deadline = startTime + periodNum*period;
+    }
+    sleepUntil(deadline);
+    periodNum++;
+
+    if (!getLatestHapticSample(sample)) {
+      continue;
+    }
+    TRACE_ZONE("streamSample");
 
-    force = hapticsData.tool->getDeviceGlobalForce();
-    forceX = force.x();
-    forceY = force.y();
-    forceZ = force.z();
-    
     M_HAPTIC_DATA_STREAM toolData;
     memset(&toolData, 0, sizeof(toolData)); 
-    auto packetIdx = controlData.client->async_call("getMsgNum");
-    auto timestamp = controlData.client->async_call("getTimestamp");
-    packetIdx.wait();
-    timestamp.wait();
-    auto packetNum = packetIdx.get().as<int>();
-    auto currTime = timestamp.get().as<double>();
-    toolData.header.serial_no = packetNum;
     toolData.header.msg_type = HAPTIC_DATA_STREAM;
-    toolData.header.timestamp = currTime;
-    toolData.posX = posX;
-    toolData.posY = posY;
-    toolData.posZ = posZ;
-    toolData.velX = velX;
-    toolData.velY = velY;
-    toolData.velZ = velZ;
-    toolData.forceX = forceX;
-    toolData.forceY = forceY;
-    toolData.forceZ = forceZ;
+    toolData.header.timestamp = getMessageHandlerTime();
+    toolData.posX = sample.pos[0];
+    toolData.posY = sample.pos[1];
+    toolData.posZ = sample.pos[2];
+    toolData.velX = sample.vel[0];
+    toolData.velY = sample.vel[1];
+    toolData.velZ = sample.vel[2];
+    toolData.forceX = sample.force[0];
+    toolData.forceY = sample.force[1];
+    toolData.forceZ = sample.force[2];
+    toolData.tick = (long long) sample.tick;
+    toolData.sampleTime = toMessageHandlerTime(sample.time);
     char collisions[4][MAX_STRING_LENGTH];
     memset(&collisions, 0, sizeof(collisions));
     int collisionIdx = 0;
     unordered_map<string, cGenericObject*>::iterator objectItr;
-    for (objectItr = controlData.objectMap.begin(); objectItr != controlData.objectMap.end(); objectItr++)
+    for (objectItr = controlData.objectMap.begin(); objectItr != controlData.objectMap.end() && collisionIdx < 4; objectItr++)
     {
       if (hapticsData.tool->isInContact(objectItr->second)) {
         string objName = objectItr->first;
@@ -94,21 +143,25 @@ void updateStreamer(void)
       }
     }
     memcpy(&(toolData.collisions), collisions, sizeof(toolData.collisions));
-    char packet[sizeof(toolData)];
-    memcpy(&packet, &toolData, sizeof(toolData));
-    vector<char> packetData(packet, packet+sizeof(packet)/sizeof(char));
-    auto sendInt = controlData.client->async_call("sendMessage", packetData, sizeof(toolData), controlData.MODULE_NUM);
-    //auto sendInt = controlData.client->async_call("sendMessage", (char *) packet, sizeof(packet), controlData.MODULE_NUM);
-    if (controlData.loggingData == true)
-    {
-      controlData.dataFile.write((const char*) packet, sizeof(toolData));
+    publishMessage(&toolData, sizeof(toolData));
+    samplesSent++;
+    if (!controlData.recordTicks.load(memory_order_relaxed)) {
+      RecordingRow row;
+      row.tick = toolData.tick;
+      row.timestamp = toolData.header.timestamp;
+      row.sampleTime = toolData.sampleTime;
+      row.posX = toolData.posX;
+      row.posY = toolData.posY;
+      row.posZ = toolData.posZ;
+      row.velX = toolData.velX;
+      row.velY = toolData.velY;
+      row.velZ = toolData.velZ;
+      row.forceX = toolData.forceX;
+      row.forceY = toolData.forceY;
+      row.forceZ = toolData.forceZ;
+      recordRow(row);
     }
-    platform::usleep(250); // 1000 microseconds = 1 millisecond
-    sendInt.wait();
-    auto sendNum = sendInt.get().as<int>();
   }
   closeMessagingSocket();
   controlData.streamerUp = false;
 }
-
-
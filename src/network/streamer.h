@@ -4,10 +4,28 @@
 #define _SENDER_H_ 
 
 #include <stdlib.h>
+#include <stdint.h>
 #include "chai3d.h"
 #include <vector>
 
+#define STREAM_RATE_DEFAULT 1000.0 // Hz
+#define STREAM_RATE_MIN 100.0
+#define STREAM_RATE_MAX 4000.0
+
+/**
+ * Counters describing the data streamer. missedDeadlines counts stream periods that were skipped
+ * because the streamer woke up more than one period late.
+ */
+struct StreamerStats
+{
+  double rate;
+  uint64_t samplesSent;
+  uint64_t missedDeadlines;
+};
+
 void startStreamer(void);
 //void closeStreamer(void);
 void updateStreamer(void);
+void setStreamRate(double rate);
+StreamerStats getStreamerStats(void);
 #endif
@@ -0,0 +1,816 @@
+#include "recorder.h"
+
+#include "core/controller.h"
+#include "core/debug.h"
+#include "core/timing.h"
+#include "core/trace.h"
+#include "network/publisher.h"
+#include "platform_compat.h"
+#include "recordingCodec.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace chai3d;
+using namespace std;
+
+/**
+ * @file recorder.h
+ * @file recorder.cpp
+ * @brief Asynchronous recording writer
+ *
+ * Recorded data never touches the disk on the thread that produces it. The producer copies each
+ * RecordingRow into a large aligned buffer from a fixed pool. When the buffer is full, or has been
+ * open for RECORDER_FLUSH_INTERVAL, it is handed to the writer thread through a lock-free
+ * single-producer, single-consumer ring. The writer gathers rows into chunks of
+ * RECORDING_CHUNK_ROWS, transposes each chunk into column blocks and writes it in the format
+ * described in recordingFormat.h, then returns the buffer to the pool through a second ring. If the
+ * writer falls so far behind that the pool is empty, rows are dropped and counted instead of
+ * blocking the producer.
+ *
+ * Starting and stopping a recording and marking trials are commands sent to the writer through a
+ * third ring. Each command carries the number of rows accepted from the producer when it was
+ * issued, and the writer applies it after exactly that many rows, so markers land between the right
+ * rows without stopping the producer. The writer opens and closes the files itself: a session is
+ * split into segments, per trial or by size, and every trial is added to the session's trial index
+ * when it ends. Segments are preallocated when opened and trimmed to their length when closed.
+ *
+ * With compression on, the writer encodes each column block with whichever encoding in
+ * recordingCodec.h makes it smallest, and keeps it raw if neither helps. This happens on the writer
+ * thread only, so the producer pays nothing for it.
+ *
+ * Pausing closes the same gate as stopping but leaves the session open: recordRow returns at its
+ * first check, nothing is written and no file is touched. The pause and the resume are written as
+ * markers, so the gap is visible on the time axis.
+ *
+ * recordRow must only be called from one thread at a time. The other functions are called from the
+ * listener thread.
+ */
+
+#define RECORDER_COMMAND_OPEN 1
+#define RECORDER_COMMAND_CLOSE 2
+#define RECORDER_COMMAND_TRIAL_START 3
+#define RECORDER_COMMAND_TRIAL_END 4
+#define RECORDER_COMMAND_PAUSE 5
+#define RECORDER_COMMAND_RESUME 6
+
+extern ControlData controlData;
+
+struct RecorderBuffer
+{
+  RecordingRow* rows;
+  size_t length; // rows in use
+};
+
+struct RecorderCommand
+{
+  int type; // RECORDER_COMMAND_*
+  int trialNum;
+  uint64_t row; // rows accepted from the producer before the command was issued
+  double time; // MessageHandler time the command was issued
+  char fileName[RECORDER_PATH_LENGTH];
+};
+
+/**
+ * Single-producer, single-consumer ring. Capacity must be a power of two.
+ */
+template <typename T, size_t Capacity>
+struct SpscRing
+{
+  T slots[Capacity];
+  atomic<size_t> head{0}; // next slot to read
+  atomic<size_t> tail{0}; // next slot to write
+
+  bool push(const T& item)
+  {
+    size_t t = tail.load(memory_order_relaxed);
+    if (t - head.load(memory_order_acquire) == Capacity) {
+      return false;
+    }
+    slots[t & (Capacity - 1)] = item;
+    tail.store(t + 1, memory_order_release);
+    return true;
+  }
+
+  T* peek()
+  {
+    size_t h = head.load(memory_order_relaxed);
+    if (h == tail.load(memory_order_acquire)) {
+      return NULL;
+    }
+    return &slots[h & (Capacity - 1)];
+  }
+
+  void pop()
+  {
+    head.store(head.load(memory_order_relaxed) + 1, memory_order_release);
+  }
+
+  size_t size()
+  {
+    return tail.load(memory_order_acquire) - head.load(memory_order_acquire);
+  }
+};
+
+/**
+ * State of the segment the writer thread is currently filling. Only used by the writer thread.
+ */
+struct RecordingFile
+{
+  int fd;
+  uint64_t offset;
+  uint64_t rowCount;
+  vector<RecordingChunkIndexEntry> index;
+  vector<RecordingMarker> markers;
+};
+
+static RecorderBuffer recorderBuffers[RECORDER_BUFFER_COUNT];
+static SpscRing<int, RECORDER_BUFFER_COUNT> freeBuffers; // writer to producer
+static SpscRing<int, RECORDER_BUFFER_COUNT> filledBuffers; // producer to writer
+static SpscRing<RecorderCommand, RECORDER_COMMAND_COUNT> commands; // listener to writer
+
+static atomic<bool> recordingOpen(false);
+static atomic<bool> recordingPaused(false);
+static atomic<int> producersInside(0);
+static atomic<uint64_t> rowsAccepted(0);
+static atomic<int> syncPolicy(RECORDER_SYNC_ON_CLOSE);
+static atomic<bool> segmentPerTrial(false);
+static atomic<uint64_t> segmentMaxBytes(0);
+static atomic<bool> compressBlocks(false);
+
+// Owned by whoever holds the gate: the producer while recording, the listener while stopping.
+static int currentBuffer = -1;
+static double currentStart = 0.0;
+
+// Owned by the writer thread.
+static RecordingFile outFile;
+static RecordingRow* chunkRows = NULL; // rows waiting to be written as the next chunk
+static size_t chunkFill = 0;
+static char* chunkOut = NULL; // transposed chunk, ready to write
+static size_t chunkOutSize = 0;
+static uint64_t* chunkColumns = NULL; // staged rows transposed, one column after another
+static uint8_t* encodeScratch = NULL; // second candidate encoding of a block
+static uint64_t rowsProcessed = 0;
+static bool sessionOpen = false;
+static string sessionBase;
+static uint32_t segmentNum = 0;
+static int trialIndexFd = -1;
+static bool trialOpen = false;
+static RecordingTrialEntry currentTrial;
+static double lastSync = 0.0;
+
+static atomic<uint64_t> bytesWritten(0);
+static atomic<uint64_t> recordsWritten(0);
+static atomic<uint64_t> recordsDropped(0);
+static atomic<uint64_t> writeErrors(0);
+static atomic<uint64_t> syncCount(0);
+static atomic<uint64_t> segmentCount(0);
+static atomic<size_t> highWaterMark(0);
+
+/**
+ * Passes the current buffer to the writer thread.
+ */
+static void handOffBuffer()
+{
+  filledBuffers.push(currentBuffer);
+  currentBuffer = -1;
+  size_t depth = filledBuffers.size();
+  size_t currMax = highWaterMark.load();
+  while (depth > currMax && !highWaterMark.compare_exchange_weak(currMax, depth)) {}
+}
+
+/**
+ * Takes a free buffer from the pool. Returns false if there is none.
+ */
+static bool acquireBuffer()
+{
+  int* index = freeBuffers.peek();
+  if (index == NULL) {
+    return false;
+  }
+  currentBuffer = *index;
+  freeBuffers.pop();
+  recorderBuffers[currentBuffer].length = 0;
+  currentStart = getSteadyTime();
+  return true;
+}
+
+/**
+ * Queues a command for the writer thread, waiting if the command ring is full.
+ */
+static void sendCommand(int type, int trialNum, const char* fileName)
+{
+  RecorderCommand command;
+  memset(&command, 0, sizeof(command));
+  command.type = type;
+  command.trialNum = trialNum;
+  command.row = rowsAccepted.load(memory_order_acquire);
+  command.time = getMessageHandlerTime();
+  if (fileName != NULL) {
+    strncpy(command.fileName, fileName, RECORDER_PATH_LENGTH - 1);
+  }
+  while (!commands.push(command)) {
+    platform::usleep(1000);
+  }
+}
+
+/**
+ * Allocates the buffer pool and the chunk staging area, and starts the writer thread. The pointer
+ * to the thread is stored in the ControlData struct.
+ */
+void startRecorder(void)
+{
+  for (int i = 0; i < RECORDER_BUFFER_COUNT; i++) {
+    recorderBuffers[i].rows = (RecordingRow*) platform::alignedAlloc(RECORDER_BUFFER_ALIGNMENT, RECORDER_BUFFER_ROWS*sizeof(RecordingRow));
+    recorderBuffers[i].length = 0;
+    freeBuffers.push(i);
+  }
+  outFile.fd = -1;
+  chunkRows = (RecordingRow*) platform::alignedAlloc(RECORDER_BUFFER_ALIGNMENT, RECORDING_CHUNK_ROWS*sizeof(RecordingRow));
+  chunkOutSize = sizeof(RecordingChunkHeader) + RECORDING_COLUMN_COUNT*sizeof(RecordingColumnBlock)
+    + RECORDING_COLUMN_COUNT*recordingPad(RECORDING_CHUNK_ROWS*sizeof(int64_t));
+  chunkOut = (char*) platform::alignedAlloc(RECORDER_BUFFER_ALIGNMENT, chunkOutSize);
+  chunkColumns = (uint64_t*) platform::alignedAlloc(RECORDER_BUFFER_ALIGNMENT, RECORDING_CHUNK_ROWS*sizeof(RecordingRow));
+  encodeScratch = (uint8_t*) platform::alignedAlloc(RECORDER_BUFFER_ALIGNMENT, RECORDING_CHUNK_ROWS*sizeof(int64_t));
+  controlData.recorderUp = true;
+  controlData.recorderThread = new cThread();
+  controlData.recorderThread->start(updateRecorder, CTHREAD_PRIORITY_GRAPHICS);
+}
+
+/**
+ * Writes length bytes to the current segment, retrying short writes.
+ */
+static void writeBytes(const void* data, size_t length)
+{
+  if (outFile.fd < 0) {
+    return;
+  }
+  const char* bytes = (const char*) data;
+  size_t written = 0;
+  while (written < length) {
+    long long res = platform::writeFile(outFile.fd, bytes + written, length - written);
+    if (res <= 0) {
+      writeErrors++;
+      debug_log(__FILE__, __LINE__, __FUNCTION__, "Error writing recording");
+      break;
+    }
+    written += (size_t) res;
+  }
+  outFile.offset += written;
+  bytesWritten += written;
+}
+
+/**
+ * Opens the current segment of the session, reserves space for it and writes the file header and
+ * the column schema.
+ */
+static void openSegment()
+{
+  string path = recordingSegmentPath(sessionBase, segmentNum);
+  outFile.fd = platform::openFileForWrite(path.c_str());
+  outFile.offset = 0;
+  outFile.rowCount = 0;
+  outFile.index.clear();
+  outFile.markers.clear();
+  chunkFill = 0;
+  if (outFile.fd < 0) {
+    writeErrors++;
+    debug_log(__FILE__, __LINE__, __FUNCTION__, std::string("Could not open recording file " + path).c_str());
+    return;
+  }
+  uint64_t maxBytes = segmentMaxBytes.load();
+  platform::preallocateFile(outFile.fd, maxBytes > 0 ? (long long) maxBytes : RECORDER_PREALLOCATE_BYTES);
+  segmentCount++;
+
+  RecordingFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+  header.version = RECORDING_VERSION;
+  header.columnCount = RECORDING_COLUMN_COUNT;
+  header.chunkRows = RECORDING_CHUNK_ROWS;
+  header.createdTime = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+  writeBytes(&header, sizeof(header));
+  writeBytes(RECORDING_COLUMNS, sizeof(RECORDING_COLUMNS));
+}
+
+/**
+ * @param values Values of one column for every staged row
+ * @param block Descriptor to fill in
+ * @param data Where the block goes, with room for the raw block
+ *
+ * Stores one column block, encoded if that makes it smaller, and returns its padded size.
+ */
+static uint64_t encodeBlock(const uint64_t* values, RecordingColumnBlock* block, char* data)
+{
+  uint64_t rawLength = chunkFill*sizeof(int64_t);
+  block->reserved = 0;
+  size_t xorLength = recordingEncodeXor(values, chunkFill, (uint8_t*) data, rawLength - 1);
+  size_t delta2Length = recordingEncodeDelta2(values, chunkFill, encodeScratch, xorLength > 0 ? xorLength - 1 : rawLength - 1);
+  if (delta2Length > 0) {
+    memcpy(data, encodeScratch, delta2Length);
+    block->encoding = RECORDING_ENCODING_DELTA2;
+    block->length = delta2Length;
+  }
+  else if (xorLength > 0) {
+    block->encoding = RECORDING_ENCODING_XOR;
+    block->length = xorLength;
+  }
+  else {
+    memcpy(data, values, rawLength);
+    block->encoding = RECORDING_ENCODING_RAW;
+    block->length = rawLength;
+  }
+  memset(data + block->length, 0, recordingPad(block->length) - block->length);
+  return recordingPad(block->length);
+}
+
+/**
+ * Transposes the staged rows into one column block per field and writes them as a chunk.
+ */
+static void writeChunk()
+{
+  if (chunkFill == 0) {
+    return;
+  }
+  TRACE_ZONE("writeChunk");
+  RecordingChunkHeader* header = (RecordingChunkHeader*) chunkOut;
+  header->magic = RECORDING_CHUNK_MAGIC;
+  header->rowCount = (uint32_t) chunkFill;
+  header->firstRow = outFile.rowCount;
+  RecordingColumnBlock* blocks = (RecordingColumnBlock*) (chunkOut + sizeof(RecordingChunkHeader));
+  char* data = (char*) (blocks + RECORDING_COLUMN_COUNT);
+  uint64_t dataLength = 0;
+  if (compressBlocks.load(memory_order_relaxed)) {
+    for (size_t r = 0; r < chunkFill; r++) {
+      const uint64_t* row = (const uint64_t*) &chunkRows[r];
+      for (int c = 0; c < RECORDING_COLUMN_COUNT; c++) {
+        chunkColumns[c*chunkFill + r] = row[c];
+      }
+    }
+    for (int c = 0; c < RECORDING_COLUMN_COUNT; c++) {
+      dataLength += encodeBlock(chunkColumns + c*chunkFill, &blocks[c], data + dataLength);
+    }
+  }
+  else {
+    uint64_t blockLength = chunkFill*sizeof(int64_t);
+    uint64_t blockStride = recordingPad(blockLength);
+    for (int c = 0; c < RECORDING_COLUMN_COUNT; c++) {
+      blocks[c].encoding = RECORDING_ENCODING_RAW;
+      blocks[c].reserved = 0;
+      blocks[c].length = blockLength;
+    }
+    for (size_t r = 0; r < chunkFill; r++) {
+      const char* row = (const char*) &chunkRows[r];
+      for (int c = 0; c < RECORDING_COLUMN_COUNT; c++) {
+        memcpy(data + c*blockStride + r*sizeof(int64_t), row + c*sizeof(int64_t), sizeof(int64_t));
+      }
+    }
+    dataLength = RECORDING_COLUMN_COUNT*blockStride;
+  }
+
+  RecordingChunkIndexEntry entry;
+  entry.offset = outFile.offset;
+  entry.firstRow = outFile.rowCount;
+  entry.rowCount = (uint32_t) chunkFill;
+  entry.reserved = 0;
+  outFile.index.push_back(entry);
+
+  size_t chunkSize = (data - chunkOut) + dataLength;
+  writeBytes(chunkOut, chunkSize);
+  outFile.rowCount += chunkFill;
+  recordsWritten += chunkFill;
+  chunkFill = 0;
+}
+
+/**
+ * Syncs the current segment to disk.
+ */
+static void syncSegment()
+{
+  platform::syncFile(outFile.fd);
+  syncCount++;
+  lastSync = getSteadyTime();
+}
+
+/**
+ * Writes the last chunk and the footer of the current segment, trims the preallocated space and
+ * closes it.
+ */
+static void closeSegment()
+{
+  if (outFile.fd < 0) {
+    return;
+  }
+  writeChunk();
+  RecordingTrailer trailer;
+  memset(&trailer, 0, sizeof(trailer));
+  trailer.indexOffset = outFile.offset;
+  trailer.chunkCount = outFile.index.size();
+  trailer.rowCount = outFile.rowCount;
+  if (!outFile.index.empty()) {
+    writeBytes(&outFile.index[0], outFile.index.size()*sizeof(RecordingChunkIndexEntry));
+  }
+  trailer.markerOffset = outFile.offset;
+  trailer.markerCount = outFile.markers.size();
+  if (!outFile.markers.empty()) {
+    writeBytes(&outFile.markers[0], outFile.markers.size()*sizeof(RecordingMarker));
+  }
+  memcpy(trailer.magic, RECORDING_TRAILER_MAGIC, sizeof(trailer.magic));
+  writeBytes(&trailer, sizeof(trailer));
+
+  platform::truncateFile(outFile.fd, (long long) outFile.offset);
+  if (syncPolicy.load() != RECORDER_SYNC_NEVER) {
+    syncSegment();
+  }
+  platform::closeFile(outFile.fd);
+  outFile.fd = -1;
+}
+
+/**
+ * Closes the current segment and continues the session in the next one.
+ */
+static void rolloverSegment()
+{
+  closeSegment();
+  segmentNum++;
+  openSegment();
+}
+
+/**
+ * Number of rows in the current segment, including those not yet written as a chunk.
+ */
+static uint64_t segmentRow()
+{
+  return outFile.rowCount + chunkFill;
+}
+
+static void addMarker(uint32_t type, int trialNum, double time)
+{
+  RecordingMarker marker;
+  marker.type = type;
+  marker.trialNum = trialNum;
+  marker.row = segmentRow();
+  marker.time = time;
+  outFile.markers.push_back(marker);
+}
+
+/**
+ * Completes the open trial and appends it to the trial index.
+ */
+static void endTrial(uint32_t flags, double time)
+{
+  currentTrial.flags = flags;
+  currentTrial.endSegment = segmentNum;
+  currentTrial.endRow = segmentRow();
+  currentTrial.endTime = time;
+  trialOpen = false;
+  if (trialIndexFd >= 0 && platform::writeFile(trialIndexFd, &currentTrial, sizeof(currentTrial)) != (long long) sizeof(currentTrial)) {
+    writeErrors++;
+  }
+}
+
+static void closeSession(double time)
+{
+  if (!sessionOpen) {
+    return;
+  }
+  if (trialOpen) {
+    endTrial(0, time);
+  }
+  closeSegment();
+  if (trialIndexFd >= 0) {
+    platform::closeFile(trialIndexFd);
+    trialIndexFd = -1;
+  }
+  sessionOpen = false;
+}
+
+static void openSession(const char* fileName)
+{
+  sessionBase = fileName;
+  segmentNum = 0;
+  trialOpen = false;
+  openSegment();
+  string indexPath = recordingTrialIndexPath(sessionBase);
+  trialIndexFd = platform::openFileForWrite(indexPath.c_str());
+  if (trialIndexFd >= 0) {
+    RecordingTrialIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDING_TRIAL_INDEX_MAGIC, sizeof(header.magic));
+    header.version = RECORDING_VERSION;
+    header.entrySize = sizeof(RecordingTrialEntry);
+    platform::writeFile(trialIndexFd, &header, sizeof(header));
+  }
+  sessionOpen = true;
+}
+
+static void applyCommand(const RecorderCommand& command)
+{
+  switch (command.type)
+  {
+    case RECORDER_COMMAND_OPEN:
+      closeSession(command.time);
+      openSession(command.fileName);
+      break;
+
+    case RECORDER_COMMAND_CLOSE:
+      closeSession(command.time);
+      break;
+
+    case RECORDER_COMMAND_TRIAL_START:
+      if (!sessionOpen) {
+        break;
+      }
+      if (trialOpen) {
+        endTrial(0, command.time);
+      }
+      if (segmentPerTrial.load() && segmentRow() > 0) {
+        rolloverSegment();
+      }
+      addMarker(RECORDING_MARKER_TRIAL_START, command.trialNum, command.time);
+      memset(&currentTrial, 0, sizeof(currentTrial));
+      currentTrial.trialNum = command.trialNum;
+      currentTrial.startSegment = segmentNum;
+      currentTrial.startRow = segmentRow();
+      currentTrial.startTime = command.time;
+      trialOpen = true;
+      break;
+
+    case RECORDER_COMMAND_TRIAL_END:
+      if (!sessionOpen) {
+        break;
+      }
+      addMarker(RECORDING_MARKER_TRIAL_END, trialOpen ? currentTrial.trialNum : -1, command.time);
+      if (trialOpen) {
+        endTrial(RECORDING_TRIAL_COMPLETE, command.time);
+      }
+      break;
+
+    case RECORDER_COMMAND_PAUSE:
+      if (sessionOpen) {
+        addMarker(RECORDING_MARKER_PAUSE, trialOpen ? currentTrial.trialNum : -1, command.time);
+      }
+      break;
+
+    case RECORDER_COMMAND_RESUME:
+      if (sessionOpen) {
+        addMarker(RECORDING_MARKER_RESUME, trialOpen ? currentTrial.trialNum : -1, command.time);
+      }
+      break;
+  }
+}
+
+/**
+ * Applies every command that was issued before the next row to be processed. With all set, applies
+ * every queued command regardless, which is used when the writer exits.
+ */
+static void applyDueCommands(bool all)
+{
+  RecorderCommand* command;
+  while ((command = commands.peek()) != NULL && (all || command->row <= rowsProcessed)) {
+    applyCommand(*command);
+    commands.pop();
+  }
+}
+
+/**
+ * Adds one row to the chunk being staged, writing the chunk when it is full and starting a new
+ * segment when the size limit is reached.
+ */
+static void stageRow(const RecordingRow& row)
+{
+  if (outFile.fd < 0) {
+    return;
+  }
+  chunkRows[chunkFill++] = row;
+  if (chunkFill == RECORDING_CHUNK_ROWS) {
+    writeChunk();
+    uint64_t maxBytes = segmentMaxBytes.load();
+    if (maxBytes > 0 && outFile.offset >= maxBytes) {
+      rolloverSegment();
+    }
+  }
+}
+
+/**
+ * Adds the rows of one filled buffer to the session, applying commands between rows as they fall
+ * due, and returns the buffer to the pool.
+ */
+static void writeBuffer(int index)
+{
+  RecorderBuffer& buffer = recorderBuffers[index];
+  for (size_t i = 0; i < buffer.length; i++) {
+    applyDueCommands(false);
+    stageRow(buffer.rows[i]);
+    rowsProcessed++;
+  }
+  applyDueCommands(false);
+  freeBuffers.push(index);
+
+  int policy = syncPolicy.load();
+  if (outFile.fd >= 0 && (policy == RECORDER_SYNC_EVERY_BUFFER
+    || (policy == RECORDER_SYNC_PERIODIC && getSteadyTime() - lastSync > RECORDER_SYNC_INTERVAL))) {
+    syncSegment();
+  }
+}
+
+/**
+ * Writer thread. Writes filled buffers in the order they were handed over and applies commands.
+ * Everything still queued when the simulation stops is written before the thread exits.
+ */
+void updateRecorder(void)
+{
+  lastSync = getSteadyTime();
+  TRACE_THREAD_NAME("recorder");
+  while (true)
+  {
+    applyDueCommands(false);
+    int* index = filledBuffers.peek();
+    if (index == NULL) {
+      if (!controlData.simulationRunning) {
+        break;
+      }
+      platform::usleep(1000);
+      continue;
+    }
+    int bufferIndex = *index;
+    filledBuffers.pop();
+    writeBuffer(bufferIndex);
+  }
+  applyDueCommands(true);
+  closeSession(getMessageHandlerTime());
+  controlData.recorderUp = false;
+}
+
+/**
+ * @param fileName Path of the first segment of the recording, which is created or truncated
+ *
+ * Starts a new recording session. Any recording in progress is stopped first. The files are opened
+ * by the writer thread, which logs an error if that fails.
+ */
+bool startRecording(const char* fileName)
+{
+  stopRecording();
+  sendCommand(RECORDER_COMMAND_OPEN, 0, fileName);
+  recordingPaused.store(false);
+  recordingOpen.store(true);
+  return true;
+}
+
+/**
+ * Closes the gate on the producer, hands the partly filled buffer to the writer and tells it to
+ * close the session once everything before it has been written. Does nothing if not recording.
+ */
+void stopRecording(void)
+{
+  if (!recordingOpen.exchange(false)) {
+    return;
+  }
+  while (producersInside.load() > 0) {
+    this_thread::yield();
+  }
+  if (currentBuffer >= 0) {
+    handOffBuffer();
+  }
+  sendCommand(RECORDER_COMMAND_CLOSE, 0, NULL);
+}
+
+/**
+ * Returns true if rows passed to recordRow are being recorded, that is, a recording is open and
+ * not paused.
+ */
+bool isRecording(void)
+{
+  return recordingOpen.load(memory_order_relaxed) && !recordingPaused.load(memory_order_relaxed);
+}
+
+/**
+ * Stops accepting rows without closing the recording, hands the partly filled buffer to the
+ * writer and marks the pause. Does nothing if not recording or already paused.
+ */
+void pauseRecording(void)
+{
+  if (!recordingOpen.load() || recordingPaused.exchange(true)) {
+    return;
+  }
+  while (producersInside.load() > 0) {
+    this_thread::yield();
+  }
+  if (currentBuffer >= 0) {
+    handOffBuffer();
+  }
+  sendCommand(RECORDER_COMMAND_PAUSE, 0, NULL);
+}
+
+/**
+ * Marks the resume and starts accepting rows again. Does nothing if not paused.
+ */
+void resumeRecording(void)
+{
+  if (!recordingOpen.load() || !recordingPaused.load()) {
+    return;
+  }
+  sendCommand(RECORDER_COMMAND_RESUME, 0, NULL);
+  recordingPaused.store(false);
+}
+
+/**
+ * @param trialNum Number of the trial that is starting
+ *
+ * Marks the start of a trial at the current position in the recording. With per-trial segments,
+ * the trial starts a new segment.
+ */
+void markTrialStart(int trialNum)
+{
+  if (recordingOpen.load()) {
+    sendCommand(RECORDER_COMMAND_TRIAL_START, trialNum, NULL);
+  }
+}
+
+/**
+ * Marks the end of the current trial and adds it to the trial index.
+ */
+void markTrialEnd(void)
+{
+  if (recordingOpen.load()) {
+    sendCommand(RECORDER_COMMAND_TRIAL_END, 0, NULL);
+  }
+}
+
+/**
+ * @param row Sample to append
+ *
+ * Appends one row to the current recording without blocking. Returns false if nothing is being
+ * recorded, the recording is paused, or the row was dropped because the buffer pool is exhausted.
+ */
+bool recordRow(const RecordingRow& row)
+{
+  if (recordingPaused.load(memory_order_relaxed)) {
+    return false;
+  }
+  producersInside.fetch_add(1);
+  if (!recordingOpen.load() || recordingPaused.load()) {
+    producersInside.fetch_sub(1);
+    return false;
+  }
+  bool stored = false;
+  if (currentBuffer >= 0 || acquireBuffer()) {
+    RecorderBuffer& buffer = recorderBuffers[currentBuffer];
+    buffer.rows[buffer.length++] = row;
+    rowsAccepted.store(rowsAccepted.load(memory_order_relaxed) + 1, memory_order_release);
+    stored = true;
+    if (buffer.length == RECORDER_BUFFER_ROWS || getSteadyTime() - currentStart > RECORDER_FLUSH_INTERVAL) {
+      handOffBuffer();
+    }
+  }
+  if (!stored) {
+    recordsDropped++;
+  }
+  producersInside.fetch_sub(1);
+  return stored;
+}
+
+/**
+ * @param policy When the writer thread syncs recordings to disk
+ */
+void setRecorderSyncPolicy(RecorderSyncPolicy policy)
+{
+  syncPolicy.store(policy);
+}
+
+/**
+ * @param compress Compress column blocks with the encodings in recordingCodec.h
+ */
+void setRecorderCompression(bool compress)
+{
+  compressBlocks.store(compress);
+}
+
+/**
+ * @param perTrial Start a new segment at every TRIAL_START
+ * @param maxBytes Start a new segment when a segment reaches this size, 0 for no limit
+ */
+void setRecorderSegmentation(bool perTrial, uint64_t maxBytes)
+{
+  segmentPerTrial.store(perTrial);
+  segmentMaxBytes.store(maxBytes);
+}
+
+/**
+ * Returns a snapshot of the recorder counters.
+ */
+RecorderStats getRecorderStats(void)
+{
+  RecorderStats stats;
+  stats.bytesWritten = bytesWritten.load();
+  stats.recordsWritten = recordsWritten.load();
+  stats.recordsDropped = recordsDropped.load();
+  stats.writeErrors = writeErrors.load();
+  stats.syncs = syncCount.load();
+  stats.segments = segmentCount.load();
+  stats.queueDepth = filledBuffers.size();
+  stats.highWaterMark = highWaterMark.load();
+  return stats;
+}
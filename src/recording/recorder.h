@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef _RECORDER_H_
+#define _RECORDER_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "chai3d.h"
+#include "recordingFormat.h"
+
+#define RECORDER_BUFFER_ROWS 8192 // rows per buffer
+#define RECORDER_BUFFER_COUNT 16 // buffers in the pool
+#define RECORDER_BUFFER_ALIGNMENT 4096
+#define RECORDER_FLUSH_INTERVAL 0.25 // seconds before a partly filled buffer is handed to the writer
+#define RECORDER_SYNC_INTERVAL 1.0 // seconds between syncs with RECORDER_SYNC_PERIODIC
+#define RECORDER_COMMAND_COUNT 64 // start, stop and marker commands waiting for the writer
+#define RECORDER_PATH_LENGTH 512
+#define RECORDER_PREALLOCATE_BYTES (64LL << 20) // space reserved per segment without a size limit
+
+/**
+ * When the writer thread asks the operating system to commit recorded data to disk.
+ */
+enum RecorderSyncPolicy
+{
+  RECORDER_SYNC_NEVER, // leave it to the operating system
+  RECORDER_SYNC_ON_CLOSE, // once, when a segment is closed
+  RECORDER_SYNC_PERIODIC, // every RECORDER_SYNC_INTERVAL seconds and on close
+  RECORDER_SYNC_EVERY_BUFFER // after every buffer written
+};
+
+/**
+ * Counters describing the recorder. highWaterMark is the largest number of filled buffers that
+ * were waiting for the writer at once. recordsDropped counts rows that were discarded because
+ * every buffer was full.
+ */
+struct RecorderStats
+{
+  uint64_t bytesWritten;
+  uint64_t recordsWritten;
+  uint64_t recordsDropped;
+  uint64_t writeErrors;
+  uint64_t syncs;
+  uint64_t segments;
+  size_t queueDepth;
+  size_t highWaterMark;
+};
+
+void startRecorder(void);
+void updateRecorder(void);
+bool startRecording(const char* fileName);
+void stopRecording(void);
+bool isRecording(void);
+void pauseRecording(void);
+void resumeRecording(void);
+bool recordRow(const RecordingRow& row);
+void markTrialStart(int trialNum);
+void markTrialEnd(void);
+void setRecorderSyncPolicy(RecorderSyncPolicy policy);
+void setRecorderSegmentation(bool perTrial, uint64_t maxBytes);
+void setRecorderCompression(bool compress);
+RecorderStats getRecorderStats(void);
+#endif
@@ -0,0 +1,149 @@
+#include "chai3d.h"
+#include "graphics/cStreamingPoints.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+
+using namespace chai3d;
+using namespace std;
+
+/**
+ * @file streamingPointsTest.cpp
+ * @brief Draws cStreamingPoints through each upload path on an offscreen context
+ *
+ * Creates a surfaceless EGL context, which Mesa provides without a display or a GPU (set
+ * LIBGL_ALWAYS_SOFTWARE=1 to force llvmpipe), and draws a point cloud through the persistent,
+ * orphaned and client-side paths. Each path streams 100000 points for a number of frames, starting
+ * from an empty buffer, then shrinks the cloud to three points and counts the lit pixels. Returns
+ * 0 if every path the context supports drew exactly those three points without OpenGL errors.
+ */
+
+#define TEST_SIZE 64 // width and height of the framebuffer
+#define TEST_POINTS 100000
+#define TEST_FRAMES 20
+
+/**
+ * Exposes render, which CHAI3D otherwise only calls while rendering a world.
+ */
+class cTestPoints : public cStreamingPoints
+{
+  public:
+    void draw()
+    {
+      cRenderOptions options;
+      options.m_single_pass_only = true;
+      options.m_render_opaque_objects_only = true;
+      options.m_creating_shadow_map = false;
+      render(options);
+    }
+};
+
+static bool createContext(void)
+{
+  EGLDisplay display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API)) {
+    printf("No EGL display with desktop OpenGL\n");
+    return false;
+  }
+  EGLint attributes[] = {EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT, EGL_NONE};
+  EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+  if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    printf("Could not create a surfaceless OpenGL context\n");
+    return false;
+  }
+  glewExperimental = GL_TRUE;
+  GLenum result = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+  if (result == GLEW_ERROR_NO_GLX_DISPLAY) {
+    result = GLEW_OK; // GLX is not needed, core functions are loaded before it is checked
+  }
+#endif
+  if (result != GLEW_OK) {
+    printf("Failed to initialize GLEW\n");
+    return false;
+  }
+  printf("%s, OpenGL %s\n", (const char*) glGetString(GL_RENDERER), (const char*) glGetString(GL_VERSION));
+
+  GLuint framebuffer;
+  GLuint colorBuffer;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glGenRenderbuffers(1, &colorBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, TEST_SIZE, TEST_SIZE);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+  glViewport(0, 0, TEST_SIZE, TEST_SIZE);
+  return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+/**
+ * Streams a changing cloud through mode, then draws three points and checks they are all that is
+ * drawn.
+ */
+static bool testMode(int mode, const char* name)
+{
+  cTestPoints* points = new cTestPoints();
+  points->setMode(mode);
+  points->setPointColor(cColorf(1.0f, 1.0f, 1.0f, 1.0f));
+  glEnable(GL_LIGHTING);
+  for (int frame = 0; frame < TEST_FRAMES; frame++) {
+    points->setNumPoints(TEST_POINTS);
+    float* positions = points->getPositions();
+    for (unsigned int i = 0; i < TEST_POINTS; i++) {
+      positions[3*i] = (float) ((i*7919u + frame) % 1000)/500.0f - 1.0f;
+      positions[3*i + 1] = (float) ((i*104729u) % 1000)/500.0f - 1.0f;
+      positions[3*i + 2] = 0.0f;
+    }
+    points->markPositionsChanged();
+    glClear(GL_COLOR_BUFFER_BIT);
+    points->draw();
+  }
+
+  points->setNumPoints(3);
+  float* positions = points->getPositions();
+  for (int i = 0; i < 3; i++) {
+    positions[3*i] = -0.5f + 0.5f*i;
+    positions[3*i + 1] = 0.5f;
+    positions[3*i + 2] = 0.0f;
+  }
+  points->markPositionsChanged();
+  glClear(GL_COLOR_BUFFER_BIT);
+  points->draw();
+  bool lighting = glIsEnabled(GL_LIGHTING) == GL_TRUE;
+
+  static unsigned char pixels[TEST_SIZE*TEST_SIZE*4];
+  glReadPixels(0, 0, TEST_SIZE, TEST_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  int lit = 0;
+  for (int p = 0; p < TEST_SIZE*TEST_SIZE; p++) {
+    lit += (pixels[4*p] > 200) ? 1 : 0;
+  }
+  delete points;
+  cStreamingPoints::releaseRetiredBuffers();
+  glDisable(GL_LIGHTING);
+  GLenum error = glGetError();
+
+  bool passed = (lit == 3) && lighting && (error == GL_NO_ERROR);
+  printf("%-10s %s: %d points drawn, lighting %s, OpenGL error 0x%x\n", name, passed ? "passed" : "FAILED", lit,
+    lighting ? "restored" : "lost", error);
+  return passed;
+}
+
+int main(int argc, char* argv[])
+{
+  if (!createContext()) {
+    return 1;
+  }
+  bool passed = true;
+  if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+    passed = testMode(STREAMING_MODE_PERSISTENT, "persistent") && passed;
+  }
+  else {
+    printf("persistent skipped: no ARB_buffer_storage\n");
+  }
+  passed = testMode(STREAMING_MODE_ORPHAN, "orphan") && passed;
+  passed = testMode(STREAMING_MODE_CLIENT, "client") && passed;
+  return passed ? 0 : 1;
+}